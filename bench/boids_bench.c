@@ -0,0 +1,144 @@
+// Host microbenchmark for the boids simulation core. Runs a seeded flock
+// with a scripted pointer path and reports ns per boid per step plus a
+// checksum of the final state, so kernel changes can be compared for both
+// speed and bit-for-bit behavior.
+//
+//   make bench-boids
+//   build/native/boids_bench [-s steps] [-t threads] [-m grid|far|knn]
+//                            [-r radius] [-a angle] [-k k] [-c] [counts...]
+//
+// -c parks the pointer in a corner for the whole run, so the flock piles
+// up there: the worst case for density-dependent neighbor search.
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "boids_sim.h"
+#include "workpool.h"
+
+#define WORLD_W 1920.0f
+#define WORLD_H 1080.0f
+#define TICK (1.0f / 60.0f)
+#define WARMUP_STEPS 30
+#define DEFAULT_STEPS 300
+#define BENCH_SEED 0xB01D5u
+
+static const char *MODE_NAMES[BOIDS_MODE_COUNT] = {"grid", "far", "knn"};
+
+typedef struct {
+  int steps;
+  int mode;
+  float radius;
+  float opening_angle;
+  int knn_k;
+  int corner;
+} BenchConfig;
+
+static double now_sec(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+}
+
+// The pointer circles the world for a while, then leaves, so both the
+// attracted and the idle cruise paths get exercised.
+static BoidsInput scripted_input(const BenchConfig *cfg, int step) {
+  BoidsInput in;
+  if (cfg->corner) {
+    in.mouse_x = 40.0f;
+    in.mouse_y = 40.0f;
+    in.mouse_present = 1;
+    return in;
+  }
+  float t = (float)step * TICK;
+  in.mouse_x = WORLD_W * (0.5f + 0.3f * cosf(t * 0.7f));
+  in.mouse_y = WORLD_H * (0.5f + 0.3f * sinf(t * 0.9f));
+  in.mouse_present = (step / 120) % 2 == 0;
+  return in;
+}
+
+static void run(const BenchConfig *cfg, int count) {
+  int steps = cfg->steps;
+  BoidsFlock flock;
+  boids_flock_init(&flock, WORLD_W, WORLD_H, BENCH_SEED);
+  boids_flock_set_mode(&flock, cfg->mode);
+  if (cfg->radius > 0.0f) boids_flock_set_radius(&flock, cfg->radius);
+  if (cfg->opening_angle >= 0.0f) boids_flock_set_opening_angle(&flock, cfg->opening_angle);
+  if (cfg->knn_k > 0) boids_flock_set_k(&flock, cfg->knn_k);
+  int reached = boids_flock_reset(&flock, count);
+  if (reached != count) {
+    printf("%8d  allocation failed (got %d)\n", count, reached);
+    boids_flock_free(&flock);
+    return;
+  }
+
+  int step = 0;
+  for (; step < WARMUP_STEPS; ++step) {
+    BoidsInput in = scripted_input(cfg, step);
+    boids_flock_step(&flock, &in, TICK);
+  }
+  double start = now_sec();
+  for (int i = 0; i < steps; ++i, ++step) {
+    BoidsInput in = scripted_input(cfg, step);
+    boids_flock_step(&flock, &in, TICK);
+  }
+  double elapsed = now_sec() - start;
+
+  double ns = elapsed * 1e9 / ((double)count * steps);
+  printf("%8d  %10.2f  %10.3f  %08x\n", count, ns, elapsed * 1e3 / steps,
+         (unsigned)boids_flock_checksum(&flock));
+  boids_flock_free(&flock);
+}
+
+static int parse_mode(const char *name) {
+  for (int m = 0; m < BOIDS_MODE_COUNT; ++m) {
+    if (!strcmp(name, MODE_NAMES[m])) return m;
+  }
+  return -1;
+}
+
+int main(int argc, char **argv) {
+  static const int default_counts[] = {1000, 5000, 20000, 50000};
+  BenchConfig cfg = {DEFAULT_STEPS, BOIDS_MODE_GRID, 0.0f, -1.0f, 0, 0};
+  int threads = 0;
+  int opt;
+  while ((opt = getopt(argc, argv, "s:t:m:r:a:k:c")) != -1) {
+    switch (opt) {
+      case 's': cfg.steps = atoi(optarg); break;
+      case 't': threads = atoi(optarg); break;
+      case 'm': cfg.mode = parse_mode(optarg); break;
+      case 'r': cfg.radius = (float)atof(optarg); break;
+      case 'a': cfg.opening_angle = (float)atof(optarg); break;
+      case 'k': cfg.knn_k = atoi(optarg); break;
+      case 'c': cfg.corner = 1; break;
+      default:
+        fprintf(stderr, "usage: %s [-s steps] [-t threads] [-m grid|far|knn] [-r radius] [-a angle] [-k k] [-c] [counts...]\n", argv[0]);
+        return 2;
+    }
+  }
+  if (cfg.steps < 1) cfg.steps = DEFAULT_STEPS;
+  if (cfg.mode < 0) {
+    fprintf(stderr, "unknown mode\n");
+    return 2;
+  }
+
+  int pool = workpool_start(threads);
+  printf("boids bench: %d steps, %d threads, simd %s, mode %s%s\n", cfg.steps, pool,
+         boids_simd_available() ? "on" : "off", MODE_NAMES[cfg.mode], cfg.corner ? ", corner" : "");
+  printf("%8s  %10s  %10s  %8s\n", "boids", "ns/boid", "ms/step", "checksum");
+
+  if (optind < argc) {
+    for (int a = optind; a < argc; ++a) run(&cfg, atoi(argv[a]));
+  } else {
+    for (size_t i = 0; i < sizeof default_counts / sizeof default_counts[0]; ++i) {
+      run(&cfg, default_counts[i]);
+    }
+  }
+
+  workpool_stop();
+  return 0;
+}
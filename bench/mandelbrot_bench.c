@@ -0,0 +1,134 @@
+// Host microbenchmark for the CPU Mandelbrot renderer. Renders a few fixed
+// views with the scalar and the SIMD kernel and reports throughput in
+// million pixel-iterations per second, plus a checksum of the smooth
+// counts and the largest difference between the two kernels' output.
+//
+//   make bench-mandelbrot
+//   build/native/mandelbrot_bench [-r reps] [-t threads] [-W width] [-H height]
+//                                 [-i max_iter] [-n]
+//
+// -n turns off the interior fast paths (cardioid/bulb tests and cycle
+// detection), to measure what they save.
+
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "mandelbrot_cpu.h"
+#include "workpool.h"
+
+#define DEFAULT_REPS 10
+#define DEFAULT_WIDTH 1280
+#define DEFAULT_HEIGHT 720
+
+typedef struct {
+  const char *name;
+  float center_x, center_y;
+  float scale;
+  int max_iter;
+} BenchView;
+
+// The full set (mostly fast escapes), seahorse valley, a spiral on the
+// boundary (long orbits, lanes escaping at very different steps) and a
+// view filled by the set interior.
+static const BenchView VIEWS[] = {
+    {"full", -0.5f, 0.0f, 1.8f, 150},
+    {"seahorse", -0.745f, 0.11f, 0.01f, 400},
+    {"spiral", -0.7436f, 0.1318f, 0.0005f, 600},
+    {"interior", -0.3f, 0.3f, 0.35f, 1000},
+};
+
+static int g_fast = 1;
+
+static double now_sec(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+}
+
+static uint32_t checksum(const float *m, size_t n) {
+  uint32_t h = 2166136261u;
+  for (size_t i = 0; i < n; ++i) {
+    uint32_t bits;
+    memcpy(&bits, &m[i], sizeof bits);
+    for (int b = 0; b < 4; ++b) {
+      h ^= (bits >> (8 * b)) & 0xFFu;
+      h *= 16777619u;
+    }
+  }
+  return h;
+}
+
+static void run(const BenchView *bv, int width, int height, int reps, int max_iter, int use_simd,
+                float *out, const float *reference) {
+  MandelbrotView view = {bv->center_x, bv->center_y, bv->scale, (float)width / (float)height,
+                         max_iter > 0 ? max_iter : bv->max_iter,
+                         g_fast ? mandelbrot_period_eps(2.0 * bv->scale / height) : 0.0f, g_fast};
+  mandelbrot_cpu_render(out, width, height, &view, use_simd);
+  uint64_t iters = 0;
+  double start = now_sec();
+  for (int r = 0; r < reps; ++r) iters += mandelbrot_cpu_render(out, width, height, &view, use_simd);
+  double elapsed = now_sec() - start;
+
+  size_t n = (size_t)width * height;
+  float diff = 0.0f;
+  if (reference) {
+    for (size_t i = 0; i < n; ++i) diff = fmaxf(diff, fabsf(out[i] - reference[i]));
+  }
+  printf("%-9s %-6s %6d %10.2f %12.1f  %08x  %.3g\n", bv->name, use_simd ? "simd" : "scalar", view.max_iter,
+         elapsed * 1e3 / reps, (double)iters / elapsed * 1e-6, (unsigned)checksum(out, n), diff);
+}
+
+int main(int argc, char **argv) {
+  int reps = DEFAULT_REPS;
+  int width = DEFAULT_WIDTH;
+  int height = DEFAULT_HEIGHT;
+  int max_iter = 0;
+  int threads = 0;
+  int opt;
+  while ((opt = getopt(argc, argv, "r:t:W:H:i:n")) != -1) {
+    switch (opt) {
+      case 'r': reps = atoi(optarg); break;
+      case 't': threads = atoi(optarg); break;
+      case 'W': width = atoi(optarg); break;
+      case 'H': height = atoi(optarg); break;
+      case 'i': max_iter = atoi(optarg); break;
+      case 'n': g_fast = 0; break;
+      default:
+        fprintf(stderr, "usage: %s [-r reps] [-t threads] [-W width] [-H height] [-i max_iter] [-n]\n", argv[0]);
+        return 2;
+    }
+  }
+  if (reps < 1) reps = DEFAULT_REPS;
+  if (width < 1 || height < 1) {
+    fprintf(stderr, "bad size\n");
+    return 2;
+  }
+
+  size_t n = (size_t)width * height;
+  float *scalar = malloc(n * sizeof(float));
+  float *simd = malloc(n * sizeof(float));
+  if (!scalar || !simd) {
+    fprintf(stderr, "out of memory\n");
+    return 1;
+  }
+
+  int pool = workpool_start(threads);
+  printf("mandelbrot bench: %dx%d, %d reps, %d threads, simd %s, fast paths %s\n", width, height, reps, pool,
+         mandelbrot_cpu_simd_available() ? "on" : "off", g_fast ? "on" : "off");
+  printf("%-9s %-6s %6s %10s %12s  %8s  %s\n", "view", "kernel", "iter", "ms/frame", "Mpix-iter/s", "checksum",
+         "max diff");
+  for (size_t v = 0; v < sizeof VIEWS / sizeof VIEWS[0]; ++v) {
+    run(&VIEWS[v], width, height, reps, max_iter, 0, scalar, NULL);
+    if (mandelbrot_cpu_simd_available()) run(&VIEWS[v], width, height, reps, max_iter, 1, simd, scalar);
+  }
+
+  workpool_stop();
+  free(scalar);
+  free(simd);
+  return 0;
+}
@@ -1,37 +1,177 @@
 let canvasIdCounter = 0;
+// Largest backing store handed to a demo, per side.
+const MAX_BACKING_SIZE = 4096;
 
-async function startModule(canvas) {
-  const moduleURL = canvas.dataset.module;
-  if (!moduleURL) return null;
+// Modules built with every demo linked in (canvases with data-demo) are
+// instantiated once per URL and shared by all canvases that name them.
+const sharedModules = new Map();
 
+// Worker builds (runtime_uses_worker) render on a pthread. A module's own
+// canvas is handed over as an OffscreenCanvas when main starts (`onTransfer`
+// runs just before); shared modules take theirs later, through the port
+// the render thread sends (see attachWorkerCalls). The promise waits until
+// that thread reports in.
+async function launchModule(moduleURL, options, args = [], onTransfer = null) {
   const dir = moduleURL.substring(0, moduleURL.lastIndexOf('/') + 1);
-
+  const moduleFactory = (await import(moduleURL)).default;
+  const Module = await moduleFactory({
+    ...options,
+    locateFile: (path) => dir + path,
+    print: (msg) => console.log(`[${moduleURL}]`, msg),
+    printErr: (msg) => console.error(`[${moduleURL}]`, msg),
+  });
+  let usesWorker = false;
   try {
-    const moduleFactory = (await import(moduleURL)).default;
-    const Module = await moduleFactory({
-      canvas,
-      __canvasSelector: `#${canvas.id}`,
-      __canvasId: canvas.id,
-      locateFile: (path) => dir + path,
-      print: (msg) => console.log(`[${moduleURL}]`, msg),
-      printErr: (msg) => console.error(`[${moduleURL}]`, msg),
+    usesWorker = !!exportFn(Module, 'runtime_uses_worker', [])?.();
+  } catch (_) {}
+  let ready = null;
+  let port = null;
+  if (usesWorker) {
+    ready = new Promise((resolve, reject) => {
+      Module.__runtimeReady = (ok) => (ok ? resolve() : reject(new Error('no WebGL2 context on the render thread')));
     });
-    const runMain = () => {
-      if (Module.callMain) {
-        Module.callMain([]);
-      } else if (Module._main) {
-        Module._main();
-      }
-    };
-    try {
-      runMain();
-    } catch (err) {
-      if (err === 'unwind' || (err && err.name === 'ExitStatus')) {
-        return Module;
-      }
+    port = new Promise((resolve) => {
+      Module.__runtimePort = resolve;
+    });
+    onTransfer?.();
+  }
+  const runMain = () => {
+    if (Module.callMain) {
+      Module.callMain(args);
+    } else if (Module._main) {
+      Module._main();
+    }
+  };
+  try {
+    runMain();
+  } catch (err) {
+    if (err !== 'unwind' && !(err && err.name === 'ExitStatus')) throw err;
+  }
+  if (ready) {
+    await ready;
+    attachWorkerCalls(Module, port);
+  }
+  Module.__usesWorker = usesWorker;
+  return Module;
+}
+
+// Worker builds: getters run on the render thread through runtime_call,
+// which waits for them; setters are queued there with runtime_post and
+// settle a promise with their result, so the page never waits on a frame.
+// Shared modules open surfaces by sending the canvas over the port.
+function attachWorkerCalls(Module, port) {
+  const argTypes = ['string', 'number', 'number', 'number', 'number', 'number'];
+  const call = Module.cwrap('runtime_call', 'number', argTypes);
+  const post = Module.cwrap('runtime_post', null, [...argTypes, 'number']);
+  const arg = (args, i) => +args[i] || 0;
+  const pending = new Map();
+  let nextRequest = 1;
+  const request = (resolve) => {
+    const id = nextRequest++;
+    pending.set(id, resolve);
+    return id;
+  };
+  const settle = (id, result) => {
+    pending.get(id)?.(result);
+    pending.delete(id);
+  };
+  Module.__runtimeSettled = settle;
+  Module.__workerCall = (name, args) => call(name, args.length, arg(args, 0), arg(args, 1), arg(args, 2), arg(args, 3));
+  Module.__workerPost = (name, args) => new Promise((resolve) => {
+    post(name, args.length, arg(args, 0), arg(args, 1), arg(args, 2), arg(args, 3), request(resolve));
+  });
+  port.then((channel) => {
+    channel.onmessage = (e) => settle(e.data.request, e.data.surface);
+  });
+  Module.__openSurface = async (demo, canvas, width, height) => {
+    const channel = await port;
+    return new Promise((resolve) => {
+      channel.postMessage({ request: request(resolve), demo, canvas, width, height }, [canvas]);
+    });
+  };
+}
+
+// The demo's switches (e.g. Module._tri_set_count) touch state that only
+// exists on the render thread in worker builds, so they are replaced with
+// the calls above: <name>_set_* exports return a promise of their result.
+function proxyDemoExports(Module, name) {
+  const proxied = (Module.__proxied ||= new Set());
+  if (proxied.has(name)) return;
+  proxied.add(name);
+  for (const key of Object.keys(Module)) {
+    if (!key.startsWith(`_${name}_`) || typeof Module[key] !== 'function') continue;
+    const exportName = key.substring(1);
+    Module[key] = exportName.startsWith(`${name}_set_`)
+      ? (...args) => Module.__workerPost(exportName, args)
+      : (...args) => Module.__workerCall(exportName, args);
+  }
+}
+
+function launchSharedModule(moduleURL) {
+  if (!sharedModules.has(moduleURL)) {
+    sharedModules.set(moduleURL, launchModule(moduleURL, {}).catch((err) => {
+      sharedModules.delete(moduleURL);
       throw err;
+    }));
+  }
+  return sharedModules.get(moduleURL);
+}
+
+// Resolves an exported C function by name, falling back to cwrap.
+function exportFn(Module, name, argTypes) {
+  const exports = Module?.instance?.exports || Module?.asm || Module?.exports || Module;
+  const direct = exports?.[name] || exports?.[`_${name}`] || Module?.[`_${name}`];
+  if (typeof direct === 'function') return direct;
+  if (!Module?.cwrap) return null;
+  try {
+    return Module.cwrap(name, null, argTypes);
+  } catch (_) {
+    return null;
+  }
+}
+
+// Threaded modules need SharedArrayBuffer, which browsers only hand to
+// cross-origin isolated pages (COOP/COEP headers); anywhere else a canvas
+// runs its data-module-fallback, a build without threads, if it has one.
+function moduleURLFor(canvas) {
+  const fallback = canvas.dataset.moduleFallback;
+  return fallback && !self.crossOriginIsolated ? fallback : canvas.dataset.module;
+}
+
+// Resolves to { Module, surface }: surface is the canvas's id in a shared
+// module, or null when the module drives the canvas on its own.
+async function startModule(canvas, onTransfer) {
+  const moduleURL = moduleURLFor(canvas);
+  if (!moduleURL) return null;
+  const demo = canvas.dataset.demo;
+
+  try {
+    if (!demo) {
+      const Module = await launchModule(moduleURL, {
+        canvas,
+        __canvasSelector: `#${canvas.id}`,
+        __canvasId: canvas.id,
+      }, [`#${canvas.id}`], onTransfer);
+      if (Module.__usesWorker) {
+        proxyDemoExports(Module, moduleURL.substring(moduleURL.lastIndexOf('/') + 1).replace(/\.js$/, ''));
+      }
+      return { Module, surface: null };
+    }
+    const Module = await launchSharedModule(moduleURL);
+    let surface;
+    if (Module.__usesWorker) {
+      const { width, height } = canvas;
+      const offscreen = canvas.transferControlToOffscreen();
+      onTransfer?.();
+      surface = await Module.__openSurface(demo, offscreen, width, height);
+      proxyDemoExports(Module, demo);
+    } else {
+      const open = Module.cwrap('runtime_open_surface', 'number', ['string', 'number', 'number']);
+      Module.__surfaceCanvas = canvas;
+      surface = open(demo, canvas.width, canvas.height);
     }
-    return Module;
+    if (surface < 0) throw new Error(`no demo named ${demo}`);
+    return { Module, surface };
   } catch (err) {
     const message = err && err.message ? err.message : String(err);
     console.error('Failed to launch demo', moduleURL, err);
@@ -48,6 +188,12 @@ function prepareCanvas(canvas) {
   const heightAttr = canvas.dataset.height || canvas.getAttribute('height');
   if (widthAttr) canvas.width = Number.parseInt(widthAttr, 10);
   if (heightAttr) canvas.height = Number.parseInt(heightAttr, 10);
+  // The declared size only fixes the aspect ratio; the backing store
+  // follows the CSS box in device pixels (see watchSize), and pinning the
+  // aspect keeps that from feeding back into the layout.
+  if (canvas.width > 0 && canvas.height > 0 && !canvas.style.aspectRatio) {
+    canvas.style.aspectRatio = `${canvas.width} / ${canvas.height}`;
+  }
 
   if (!canvas.id) {
     canvas.id = `demo-canvas-${canvasIdCounter++}`;
@@ -74,9 +220,17 @@ function prepareCanvas(canvas) {
   applyPoster();
 
   let modulePromise = null;
-  let moduleExports = null;
+  // Backing-store size; once the canvas is transferred to a render thread
+  // it can no longer be set here, and the runtime applies it instead.
+  let backingWidth = canvas.width;
+  let backingHeight = canvas.height;
+  // Backing pixels per CSS pixel.
+  let pixelRatio = 1;
+  let transferred = false;
   let setActive = null;
   let updateMouse = null;
+  let resizeCanvas = null;
+  let setPixelRatio = null;
   let started = false;
   const computeInitialVisibility = () => {
     const rect = canvas.getBoundingClientRect();
@@ -101,27 +255,24 @@ function prepareCanvas(canvas) {
   const ensureModule = async () => {
     if (!modulePromise) {
       canvas.classList.add('demo-activating');
-      modulePromise = startModule(canvas)
-        .then((Module) => {
-          moduleExports = Module?.instance?.exports || Module?.asm || Module?.exports || Module;
-          const candidate = moduleExports?.set_active || moduleExports?._set_active || Module?._set_active;
-          const mouseCandidate = moduleExports?.update_mouse || moduleExports?._update_mouse || Module?._update_mouse;
-          if (typeof candidate === 'function') setActive = (value) => candidate(value | 0);
-          if (typeof mouseCandidate === 'function') updateMouse = (x, y, present) => mouseCandidate(x, y, present);
-          if (Module?.cwrap) {
-            if (!setActive) {
-              try {
-                const wrapped = Module.cwrap('set_active', null, ['number']);
-                setActive = (value) => wrapped(value | 0);
-              } catch (_) { setActive = null; }
-            }
-            if (!updateMouse) {
-              try {
-                const wrappedMouse = Module.cwrap('update_mouse', null, ['number', 'number', 'number']);
-                updateMouse = (x, y, present) => wrappedMouse(x, y, present);
-              } catch (_) { updateMouse = null; }
-            }
-          }
+      modulePromise = startModule(canvas, () => { transferred = true; })
+        .then(({ Module, surface }) => {
+          // Shared modules take the surface id ahead of the usual arguments.
+          const bind = (name, surfaceName, argTypes) => {
+            if (surface === null) return exportFn(Module, name, argTypes);
+            const fn = exportFn(Module, surfaceName, ['number', ...argTypes]);
+            return fn && ((...args) => fn(surface, ...args));
+          };
+          const active = bind('set_active', 'runtime_surface_set_active', ['number']);
+          const mouse = bind('update_mouse', 'runtime_surface_update_mouse', ['number', 'number', 'number']);
+          const resize = bind('resize_canvas', 'runtime_surface_resize', ['number', 'number']);
+          const ratio = bind('set_pixel_ratio', 'runtime_surface_set_pixel_ratio', ['number']);
+          if (active) setActive = (value) => active(value | 0);
+          if (mouse) updateMouse = (x, y, present) => mouse(x, y, present);
+          if (resize) resizeCanvas = (w, h) => resize(w | 0, h | 0);
+          if (ratio) setPixelRatio = (value) => ratio(+value);
+          setPixelRatio?.(pixelRatio);
+          resizeCanvas?.(backingWidth, backingHeight);
           applyActiveState();
           return Module;
         })
@@ -143,15 +294,15 @@ function prepareCanvas(canvas) {
     clearPoster();
     await ensureModule();
     applyActiveState();
-    updateMouse?.(canvas.width * 0.5, canvas.height * 0.5, 0);
+    updateMouse?.(backingWidth * 0.5, backingHeight * 0.5, 0);
     try { canvas.focus({ preventScroll: true }); } catch (_) {}
   };
 
   const handlePointerMove = (ev) => {
     if (!started || !updateMouse || !isVisible) return;
     const rect = canvas.getBoundingClientRect();
-    const scaleX = canvas.width / rect.width;
-    const scaleY = canvas.height / rect.height;
+    const scaleX = backingWidth / rect.width;
+    const scaleY = backingHeight / rect.height;
     const x = (ev.clientX - rect.left) * scaleX;
     const y = (ev.clientY - rect.top) * scaleY;
     updateMouse(x, y, 1);
@@ -173,6 +324,76 @@ function prepareCanvas(canvas) {
   canvas.addEventListener('pointerleave', handlePointerLeave, { passive: true });
   canvas.addEventListener('blur', handlePointerLeave);
 
+  // Keeps the backing store at the CSS size times devicePixelRatio and
+  // tells the runtime, which picks its render resolution from there. The
+  // ratio is what the backing store actually got, after rounding and the
+  // size cap, so demos working in CSS pixels (boids) see the real CSS size.
+  const applyBackingSize = (width, height) => {
+    const w = Math.max(1, Math.min(MAX_BACKING_SIZE, Math.round(width)));
+    const h = Math.max(1, Math.min(MAX_BACKING_SIZE, Math.round(height)));
+    const ratio = canvas.clientWidth > 0 ? w / canvas.clientWidth : window.devicePixelRatio || 1;
+    if (ratio !== pixelRatio) {
+      pixelRatio = ratio;
+      try {
+        setPixelRatio?.(ratio);
+      } catch (err) {
+        console.error('set_pixel_ratio failed', err);
+      }
+    }
+    if (w === backingWidth && h === backingHeight) return;
+    backingWidth = w;
+    backingHeight = h;
+    if (!transferred) {
+      canvas.width = w;
+      canvas.height = h;
+    }
+    try {
+      resizeCanvas?.(w, h);
+    } catch (err) {
+      console.error('resize_canvas failed', err);
+    }
+  };
+  const measure = () => {
+    const dpr = window.devicePixelRatio || 1;
+    if (canvas.clientWidth > 0) applyBackingSize(canvas.clientWidth * dpr, canvas.clientHeight * dpr);
+  };
+  const watchSize = () => {
+    if ('ResizeObserver' in window) {
+      const observer = new ResizeObserver((entries) => {
+        for (const entry of entries) {
+          const device = entry.devicePixelContentBoxSize?.[0];
+          if (device) {
+            applyBackingSize(device.inlineSize, device.blockSize);
+          } else {
+            const box = entry.contentBoxSize?.[0];
+            const dpr = window.devicePixelRatio || 1;
+            if (box) applyBackingSize(box.inlineSize * dpr, box.blockSize * dpr);
+            else measure();
+          }
+        }
+      });
+      try {
+        observer.observe(canvas, { box: 'device-pixel-content-box' });
+      } catch (_) {
+        observer.observe(canvas);
+      }
+    } else {
+      window.addEventListener('resize', measure, { passive: true });
+    }
+    // Zooming or moving to another screen changes the ratio without
+    // always resizing the box; the query matches only the current ratio.
+    const watchRatio = () => {
+      const query = window.matchMedia?.(`(resolution: ${window.devicePixelRatio || 1}dppx)`);
+      query?.addEventListener?.('change', () => {
+        measure();
+        watchRatio();
+      }, { once: true });
+    };
+    watchRatio();
+    measure();
+  };
+  watchSize();
+
   if ('IntersectionObserver' in window) {
     const observer = new IntersectionObserver((entries) => {
       for (const entry of entries) {
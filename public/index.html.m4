@@ -16,7 +16,7 @@ include(`tpl/header.html')
   <noscript>
     <p>Enable JavaScript to run the WebGL demo. The source lives in <code>src/tri.c</code>.</p>
   </noscript>
-  <canvas data-module="/demos/tri/tri.js" data-width="640" data-height="360" data-poster="/posters/tri.png"></canvas>
+  <canvas data-module="/demos/all/all.js" data-module-fallback="/demos/all-st/all-st.js" data-demo="tri" data-width="640" data-height="360" data-poster="/posters/tri.png"></canvas>
   <details class="source">
     <summary>Source: <code>src/tri.c</code></summary>
     include(`public/snippets/tri.html')
@@ -29,7 +29,7 @@ include(`tpl/header.html')
   <noscript>
     <p>Enable JavaScript to run the WebGL demo. The source lives in <code>src/plasma.c</code>.</p>
   </noscript>
-  <canvas data-module="/demos/plasma/plasma.js" data-width="640" data-height="360" data-poster="/posters/plasma.png"></canvas>
+  <canvas data-module="/demos/all/all.js" data-module-fallback="/demos/all-st/all-st.js" data-demo="plasma" data-width="640" data-height="360" data-poster="/posters/plasma.png"></canvas>
   <details class="source">
     <summary>Source: <code>src/plasma.c</code></summary>
     include(`public/snippets/plasma.html')
@@ -38,11 +38,11 @@ include(`tpl/header.html')
 
 <section class="demo">
   <h2>Mandelbrot Explorer</h2>
-  <p>Keyboard-driven Mandelbrot (arrows to pan, Z/X to zoom) rendered in plain GLSL.</p>
+  <p>Keyboard-driven Mandelbrot (arrows to pan, Z/X to zoom) rendered in plain GLSL. Past the limits of 32-bit floats it switches to perturbation against a high-precision reference orbit, so you can keep zooming to around 1e-28.</p>
   <noscript>
     <p>Enable JavaScript to run the WebGL demo. The source lives in <code>src/mandelbrot.c</code>.</p>
   </noscript>
-  <canvas data-module="/demos/mandelbrot/mandelbrot.js" data-width="640" data-height="360" data-poster="/posters/mandelbrot.png"></canvas>
+  <canvas data-module="/demos/all/all.js" data-module-fallback="/demos/all-st/all-st.js" data-demo="mandelbrot" data-width="640" data-height="360" data-poster="/posters/mandelbrot.png"></canvas>
   <details class="source">
     <summary>Source: <code>src/mandelbrot.c</code></summary>
     include(`public/snippets/mandelbrot.html')
@@ -51,11 +51,11 @@ include(`tpl/header.html')
 
 <section class="demo">
   <h2>Boids</h2>
-  <p>Flocking simulation that follows your pointer; once it leaves the canvas a velocity damping term settles the flock.</p>
+  <p>Flocking simulation that follows your pointer; once it leaves the canvas a velocity damping term settles the flock. Z scatters the flock, X switches between the CPU and GPU (transform feedback) engines, C cycles the CPU neighborhood mode.</p>
   <noscript>
     <p>Enable JavaScript to run this demo. The source lives in <code>src/boids.c</code>.</p>
   </noscript>
-  <canvas data-module="/demos/boids/boids.js" data-width="640" data-height="360" data-poster="/posters/boids.png"></canvas>
+  <canvas data-module="/demos/all/all.js" data-module-fallback="/demos/all-st/all-st.js" data-demo="boids" data-width="640" data-height="360" data-poster="/posters/boids.png"></canvas>
   <details class="source">
     <summary>Source: <code>src/boids.c</code></summary>
     include(`public/snippets/boids.html')
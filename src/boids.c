@@ -1,65 +1,97 @@
 #include <GLES3/gl3.h>
+#include <emscripten.h>
 #include <math.h>
 #include <stdint.h>
 #include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
 
+#include "boids_gpu.h"
+#include "boids_sim.h"
 #include "demo_app.h"
-
-#define MAX_BOIDS 160
-#define NEIGHBOR_RADIUS 80.0f
-#define SEPARATION_RADIUS 70.0f
-#define MAX_SPEED 400.0f
-#define MAX_FORCE 200.0f
-#define VELOCITY_DAMP_ACTIVE 0.985f
-#define VELOCITY_DAMP_IDLE 0.9f
-#define EDGE_THRESHOLD 60.0f
-#define EDGE_FORCE 800.0f
-
+#include "workpool.h"
+
+#define DEFAULT_BOIDS 160
+#define DEFAULT_GPU_BOIDS 16384
+#define DEFAULT_TICK_RATE 60.0
+#define MAX_FRAME_DT 0.05
+#define MAX_TICKS_PER_FRAME 4
+#define INSTANCE_RING 3
+#define DEFAULT_BUDGET_MS 4.0
+#define MIN_AUTO_BOIDS 64
+#define MAX_AUTO_BOIDS 100000
+// Population controller: grow while the smoothed cost is under
+// CONTROL_GROW_BELOW of the budget, shrink once it is over, and hold in
+// between. After each change it waits CONTROL_SETTLE_FRAMES so the
+// estimate reflects the new count before deciding again.
+#define CONTROL_GROW_BELOW 0.7
+#define CONTROL_SMOOTHING 0.1
+#define CONTROL_SETTLE_FRAMES 20
+
+// Render size in device pixels, and the world the flock lives in, in CSS
+// pixels: the radii, speeds and glyph are CSS sizes, so the flock looks the
+// same at any devicePixelRatio and only the draw is scaled.
 static int g_width = 0;
 static int g_height = 0;
+static float g_world_w = 0.0f;
+static float g_world_h = 0.0f;
+static float g_pixel_ratio = 1.0f;
 static int g_active = 0;
 
 static GLuint g_program = 0;
-static GLuint g_vao = 0;
-static GLuint g_vbo = 0;
 static GLint g_time_loc = -1;
-static GLint g_resolution_loc = -1;
+static GLint g_world_loc = -1;
+
+// Per-instance data streamed every frame through a small ring of buffers;
+// a fence per slot tells us whether the GPU is still reading it.
+typedef struct {
+  float x, y;
+  int16_t dir_x, dir_y;
+} BoidInstance;
+
+static GLuint g_ring_vao[INSTANCE_RING] = {0};
+static GLuint g_ring_vbo[INSTANCE_RING] = {0};
+static GLsync g_ring_fence[INSTANCE_RING] = {0};
+static int g_ring_capacity = 0;
+static int g_ring_slot = 0;
+
+// The CPU engine's state; the simulation itself lives in boids_sim.c.
+static BoidsFlock g_flock;
+static BoidInstance *g_instances = NULL;
+static int g_instance_capacity = 0;
+
+enum { ENGINE_CPU = 0, ENGINE_GPU = 1 };
+static int g_engine = ENGINE_CPU;
+static int g_gpu_ok = 0;
+static int g_gpu_boids = DEFAULT_GPU_BOIDS;
+
+static double g_tick_rate = DEFAULT_TICK_RATE;
+static double g_accumulator = 0.0;
 
-static float g_positions[MAX_BOIDS][2];
-static float g_velocities[MAX_BOIDS][2];
 static float g_mouse_x = 0.0f;
 static float g_mouse_y = 0.0f;
 static int g_mouse_present = 0;
 
-static uint32_t g_rng = 1u;
-
-static float frand(void) {
-  g_rng = g_rng * 1664525u + 1013904223u;
-  return (float)((g_rng >> 8) & 0xFFFFFFu) / (float)0x1000000u;
-}
-
-static float wrap_distance(float delta, float extent) {
-  if (extent <= 0.0f) return delta;
-  float half = extent * 0.5f;
-  while (delta > half) delta -= extent;
-  while (delta < -half) delta += extent;
-  return delta;
-}
-
-static float wrap_mod(float value, float extent) {
-  if (extent <= 0.0f) return value;
-  float wrapped = fmodf(value, extent);
-  if (wrapped < 0.0f) wrapped += extent;
-  return wrapped;
-}
+static double g_budget_ms = DEFAULT_BUDGET_MS;
+static int g_auto_count = 1;
+static double g_frame_cost_ms = 0.0;
+static int g_settle_frames = 0;
 
+// One oriented triangle per boid, placed and wrapped in the vertex shader.
 static const char *VERT_SRC =
     "#version 300 es\n"
-    "layout(location=0) in vec2 a_clip;\n"
-    "uniform vec2 u_resolution;\n"
+    "layout(location=0) in vec2 a_pos;\n"
+    "layout(location=1) in vec2 a_dir;\n"
+    "uniform vec2 u_world;\n"
+    "const vec2 GLYPH[3] = vec2[3](vec2(7.0, 0.0), vec2(-4.0, 3.5), vec2(-4.0, -3.5));\n"
     "void main(){\n"
-    "  gl_Position = vec4(a_clip, 0.0, 1.0);\n"
-    "  gl_PointSize = 6.0;\n"
+    "  vec2 world = max(u_world, vec2(1.0));\n"
+    "  vec2 p = mod(a_pos, world);\n"
+    "  vec2 dir = dot(a_dir, a_dir) > 0.0 ? normalize(a_dir) : vec2(1.0, 0.0);\n"
+    "  vec2 local = GLYPH[gl_VertexID];\n"
+    "  p += vec2(local.x * dir.x - local.y * dir.y, local.x * dir.y + local.y * dir.x);\n"
+    "  vec2 clip = p / world * 2.0 - 1.0;\n"
+    "  gl_Position = vec4(clip.x, -clip.y, 0.0, 1.0);\n"
     "}\n";
 
 static const char *FRAG_SRC =
@@ -71,9 +103,7 @@ static const char *FRAG_SRC =
     "  float r = 0.6 + 0.4 * sin(u_time * 1.7 + gl_FragCoord.x * 0.02);\n"
     "  float g = 0.6 + 0.4 * sin(u_time * 1.3 + gl_FragCoord.y * 0.02 + 1.7);\n"
     "  float b = 0.7 + 0.3 * sin(u_time * 1.1 + 3.1);\n"
-    "  vec2 uv = (gl_PointCoord - 0.5) * 2.0;\n"
-    "  float alpha = smoothstep(1.0, 0.2, dot(uv, uv));\n"
-    "  fragColor = vec4(r, g, b, alpha);\n"
+    "  fragColor = vec4(r, g, b, 1.0);\n"
     "}\n";
 
 static GLuint compile_shader(GLenum type, const char *src) {
@@ -117,244 +147,369 @@ static GLuint link_program(GLuint vs, GLuint fs) {
   return prog;
 }
 
-static void reset_boids(void) {
-  for (int i = 0; i < MAX_BOIDS; ++i) {
-    g_positions[i][0] = frand() * g_width;
-    g_positions[i][1] = frand() * g_height;
-    float angle = frand() * 6.2831853f;
-    float speed = 60.0f + frand() * 40.0f;
-    g_velocities[i][0] = cosf(angle) * speed;
-    g_velocities[i][1] = sinf(angle) * speed;
+static int ensure_instance_capacity(int count) {
+  if (count <= g_instance_capacity) return 1;
+  BoidInstance *p = realloc(g_instances, (size_t)count * sizeof *p);
+  if (!p) return 0;
+  g_instances = p;
+  g_instance_capacity = count;
+  return 1;
+}
+
+static void reset_boids(int count) {
+  if (!ensure_instance_capacity(count)) count = g_instance_capacity;
+  boids_flock_reset(&g_flock, count);
+}
+
+// Scatters new boids or retires an even spread of the flock; survivors
+// keep their state.
+static void apply_count(int count) {
+  if (count < 0) count = 0;
+  if (!ensure_instance_capacity(count)) count = g_instance_capacity;
+  boids_flock_set_count(&g_flock, count);
+}
+
+// Called once per frame with the time spent simulating and drawing. Draw
+// time is what the CPU spends issuing it; GPU time is not visible here,
+// so the controller only drives the CPU engine.
+static void control_population(double cost_ms) {
+  g_frame_cost_ms += (cost_ms - g_frame_cost_ms) * CONTROL_SMOOTHING;
+  if (!g_auto_count || g_engine != ENGINE_CPU) return;
+  if (g_settle_frames > 0) {
+    g_settle_frames--;
+    return;
+  }
+  int count = g_flock.count;
+  int target = count;
+  if (g_frame_cost_ms > g_budget_ms) {
+    // Cost is close to linear in the count; aim back inside the band,
+    // but never drop more than half at once.
+    target = (int)(count * (g_budget_ms * 0.85 / g_frame_cost_ms));
+    if (target < count / 2) target = count / 2;
+  } else if (g_frame_cost_ms < g_budget_ms * CONTROL_GROW_BELOW) {
+    target = count + (count / 8 > 16 ? count / 8 : 16);
+  }
+  if (target < MIN_AUTO_BOIDS) target = MIN_AUTO_BOIDS;
+  if (target > MAX_AUTO_BOIDS) target = MAX_AUTO_BOIDS;
+  if (target != count) {
+    apply_count(target);
+    g_settle_frames = CONTROL_SETTLE_FRAMES;
   }
 }
 
-void demo_app_init(int width, int height) {
+// Follows the render size and the pixel ratio into world units.
+static void update_world(int width, int height) {
   g_width = width;
   g_height = height;
+  g_pixel_ratio = (float)runtime_pixel_ratio();
+  if (!(g_pixel_ratio > 0.0f)) g_pixel_ratio = 1.0f;
+  g_world_w = (float)width / g_pixel_ratio;
+  g_world_h = (float)height / g_pixel_ratio;
+}
+
+void demo_app_init(int width, int height) {
   g_active = 0;
-  g_rng = 0x1234ABCDu ^ (uint32_t)(width * 131u + height);
+  update_world(width, height);
+  boids_flock_init(&g_flock, g_world_w, g_world_h,
+                   0x1234ABCDu ^ (uint32_t)((int)g_world_w * 131u + (int)g_world_h));
+  workpool_start(0);
 
   GLuint vs = compile_shader(GL_VERTEX_SHADER, VERT_SRC);
   GLuint fs = compile_shader(GL_FRAGMENT_SHADER, FRAG_SRC);
   g_program = link_program(vs, fs);
   g_time_loc = glGetUniformLocation(g_program, "u_time");
-  g_resolution_loc = glGetUniformLocation(g_program, "u_resolution");
-
-  glGenVertexArrays(1, &g_vao);
-  glBindVertexArray(g_vao);
-
-  glGenBuffers(1, &g_vbo);
-  glBindBuffer(GL_ARRAY_BUFFER, g_vbo);
-  glBufferData(GL_ARRAY_BUFFER, MAX_BOIDS * 2 * sizeof(float), NULL, GL_DYNAMIC_DRAW);
-  glEnableVertexAttribArray(0);
-  glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 2 * sizeof(float), (void *)0);
+  g_world_loc = glGetUniformLocation(g_program, "u_world");
+
+  glGenVertexArrays(INSTANCE_RING, g_ring_vao);
+  glGenBuffers(INSTANCE_RING, g_ring_vbo);
+  for (int i = 0; i < INSTANCE_RING; ++i) {
+    glBindVertexArray(g_ring_vao[i]);
+    glBindBuffer(GL_ARRAY_BUFFER, g_ring_vbo[i]);
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, sizeof(BoidInstance), (void *)offsetof(BoidInstance, x));
+    glVertexAttribDivisor(0, 1);
+    glEnableVertexAttribArray(1);
+    glVertexAttribPointer(1, 2, GL_SHORT, GL_TRUE, sizeof(BoidInstance), (void *)offsetof(BoidInstance, dir_x));
+    glVertexAttribDivisor(1, 1);
+  }
 
-  reset_boids();
+  reset_boids(DEFAULT_BOIDS);
+  g_gpu_ok = boids_gpu_init();
+  if (g_gpu_ok) boids_gpu_reset(g_gpu_boids, g_world_w, g_world_h, boids_rng_next(&g_flock.rng));
   demo_app_resize(width, height);
 }
 
 void demo_app_resize(int width, int height) {
-  g_width = width;
-  g_height = height;
-  glViewport(0, 0, g_width, g_height);
+  update_world(width, height);
+  boids_flock_resize(&g_flock, g_world_w, g_world_h);
+  if (g_gpu_ok) boids_gpu_resize(g_world_w, g_world_h);
 }
 
-void demo_app_frame(double time_sec, double dt_sec) {
-  if (!g_active) return;
-  float dt = (float)dt_sec;
-  if (dt > 0.05f) dt = 0.05f;
-
-  for (int i = 0; i < MAX_BOIDS; ++i) {
-    float px = g_positions[i][0];
-    float py = g_positions[i][1];
-    float px_screen = wrap_mod(px, (float)g_width);
-    float py_screen = wrap_mod(py, (float)g_height);
-    float vx = g_velocities[i][0];
-    float vy = g_velocities[i][1];
-
-    float align_x = 0.f, align_y = 0.f;
-    float cohesion_x = 0.f, cohesion_y = 0.f;
-    float separation_x = 0.f, separation_y = 0.f;
-    int neighbors = 0;
-
-    for (int j = 0; j < MAX_BOIDS; ++j) {
-      if (i == j) continue;
-      float dx = wrap_distance(g_positions[j][0] - px, (float)g_width);
-      float dy = wrap_distance(g_positions[j][1] - py, (float)g_height);
-
-      float dist2 = dx * dx + dy * dy;
-      if (dist2 < NEIGHBOR_RADIUS * NEIGHBOR_RADIUS) {
-        align_x += g_velocities[j][0];
-        align_y += g_velocities[j][1];
-        cohesion_x += px + dx;
-        cohesion_y += py + dy;
-        if (dist2 < SEPARATION_RADIUS * SEPARATION_RADIUS && dist2 > 0.0001f) {
-          separation_x -= dx / dist2;
-          separation_y -= dy / dist2;
-        }
-        neighbors++;
-      }
-    }
-
-    float accel_x = 0.f;
-    float accel_y = 0.f;
-
-    if (neighbors > 0) {
-      float inv = 1.0f / neighbors;
-      align_x = (align_x * inv - vx) * 1.2f;
-      align_y = (align_y * inv - vy) * 1.2f;
-
-      cohesion_x = ((cohesion_x * inv) - px) * 0.008f;
-      cohesion_y = ((cohesion_y * inv) - py) * 0.008f;
-
-      separation_x *= 10.0f;
-      separation_y *= 10.0f;
-
-      accel_x += align_x + cohesion_x + separation_x;
-      accel_y += align_y + cohesion_y + separation_y;
-    }
+// Advances the active engine by one fixed tick. Inputs are sampled once per
+// tick and all randomness comes from the flock's seeded RNG, so a given seed
+// and input sequence always produces the same flock.
+static void step_simulation(float dt) {
+  if (g_engine == ENGINE_GPU) {
+    boids_gpu_step(dt, g_mouse_x, g_mouse_y, g_mouse_present, boids_rng_next(&g_flock.rng));
+    return;
+  }
+  BoidsInput input = {g_mouse_x, g_mouse_y, g_mouse_present};
+  boids_flock_step(&g_flock, &input, dt);
+}
 
-    if (g_mouse_present) {
-      float dxm = g_mouse_x - px_screen;
-      float dym = g_mouse_y - py_screen;
-      float distm2 = dxm * dxm + dym * dym;
-      if (distm2 > 25.0f) {
-        float inv = 1.0f / sqrtf(distm2);
-        accel_x += dxm * inv * 160.0f;
-        accel_y += dym * inv * 160.0f;
-      }
-    }
+static int16_t quantize_unit(float v) {
+  return (int16_t)lrintf(v * 32767.0f);
+}
 
-    if (g_width > 0) {
-      float left_dist = px_screen;
-      if (left_dist < EDGE_THRESHOLD) {
-        float t = (EDGE_THRESHOLD - left_dist) * (1.0f / EDGE_THRESHOLD);
-        accel_x += EDGE_FORCE * t;
-      }
-      float right_dist = (float)g_width - px_screen;
-      if (right_dist < EDGE_THRESHOLD) {
-        float t = (EDGE_THRESHOLD - right_dist) * (1.0f / EDGE_THRESHOLD);
-        accel_x -= EDGE_FORCE * t;
-      }
-    }
-    if (g_height > 0) {
-      float top_dist = py_screen;
-      if (top_dist < EDGE_THRESHOLD) {
-        float t = (EDGE_THRESHOLD - top_dist) * (1.0f / EDGE_THRESHOLD);
-        accel_y += EDGE_FORCE * t;
-      }
-      float bottom_dist = (float)g_height - py_screen;
-      if (bottom_dist < EDGE_THRESHOLD) {
-        float t = (EDGE_THRESHOLD - bottom_dist) * (1.0f / EDGE_THRESHOLD);
-        accel_y -= EDGE_FORCE * t;
-      }
+// Picks the next ring slot. If the GPU may still be reading it, the storage
+// is orphaned instead of waiting, so uploads never stall on buffer reuse.
+static void acquire_ring_slot(void) {
+  g_ring_slot = (g_ring_slot + 1) % INSTANCE_RING;
+  glBindBuffer(GL_ARRAY_BUFFER, g_ring_vbo[g_ring_slot]);
+  GLsync fence = g_ring_fence[g_ring_slot];
+  if (g_ring_capacity < g_instance_capacity) {
+    g_ring_capacity = g_instance_capacity;
+    for (int i = 0; i < INSTANCE_RING; ++i) {
+      glBindBuffer(GL_ARRAY_BUFFER, g_ring_vbo[i]);
+      glBufferData(GL_ARRAY_BUFFER, (GLsizeiptr)g_ring_capacity * sizeof(BoidInstance), NULL, GL_STREAM_DRAW);
     }
+    glBindBuffer(GL_ARRAY_BUFFER, g_ring_vbo[g_ring_slot]);
+  } else if (fence && glClientWaitSync(fence, 0, 0) == GL_TIMEOUT_EXPIRED) {
+    glBufferData(GL_ARRAY_BUFFER, (GLsizeiptr)g_ring_capacity * sizeof(BoidInstance), NULL, GL_STREAM_DRAW);
+  }
+  if (fence) {
+    glDeleteSync(fence);
+    g_ring_fence[g_ring_slot] = 0;
+  }
+}
 
+static void draw_cpu(float time_sec, float alpha) {
+  const BoidArrays *cur = &g_flock.cur;
+  const BoidArrays *prev = &g_flock.prev;
+  int count = g_flock.count;
+  BoidInstance *inst = g_instances;
+  for (int i = 0; i < count; ++i) {
+    inst[i].x = prev->x[i] + boids_wrap_distance(cur->x[i] - prev->x[i], g_flock.width) * alpha;
+    inst[i].y = prev->y[i] + boids_wrap_distance(cur->y[i] - prev->y[i], g_flock.height) * alpha;
+    float vx = cur->vx[i];
+    float vy = cur->vy[i];
     float speed = sqrtf(vx * vx + vy * vy);
-    if (speed > 0.0001f) {
-      accel_x += (vx / speed) * 6.0f;
-      accel_y += (vy / speed) * 6.0f;
-    }
-
-    float acc_mag = sqrtf(accel_x * accel_x + accel_y * accel_y);
-    if (acc_mag > MAX_FORCE) {
-      float scale = MAX_FORCE / acc_mag;
-      accel_x *= scale;
-      accel_y *= scale;
-    }
-
-    vx += accel_x * dt;
-    vy += accel_y * dt;
-    float new_speed = sqrtf(vx * vx + vy * vy);
-    if (new_speed > MAX_SPEED) {
-      float scale = MAX_SPEED / new_speed;
-      vx *= scale;
-      vy *= scale;
-    }
-
-    float damp = g_mouse_present ? VELOCITY_DAMP_ACTIVE : VELOCITY_DAMP_IDLE;
-    vx *= damp;
-    vy *= damp;
-
-    if (!g_mouse_present) {
-      float cruise = 80.0f;
-      float speed_after = sqrtf(vx * vx + vy * vy);
-      if (speed_after < cruise) {
-        if (speed_after > 0.0001f) {
-          float scale = cruise / speed_after;
-          vx *= scale;
-          vy *= scale;
-        } else {
-          // Re-inject a tiny random push to keep idle motion alive.
-          float angle = frand() * 6.2831853f;
-          vx = cosf(angle) * cruise;
-          vy = sinf(angle) * cruise;
-        }
-      }
-    }
-
-    px += vx * dt;
-    py += vy * dt;
-
-    g_positions[i][0] = px;
-    g_positions[i][1] = py;
-    g_velocities[i][0] = vx;
-    g_velocities[i][1] = vy;
+    float inv = speed > 0.0001f ? 1.0f / speed : 0.0f;
+    inst[i].dir_x = quantize_unit(vx * inv);
+    inst[i].dir_y = quantize_unit(vy * inv);
   }
 
-  float verts[MAX_BOIDS * 2];
-  float inv_w = g_width > 0 ? 1.0f / g_width : 0.0f;
-  float inv_h = g_height > 0 ? 1.0f / g_height : 0.0f;
-  for (int i = 0; i < MAX_BOIDS; ++i) {
-    float screen_x = wrap_mod(g_positions[i][0], (float)g_width);
-    float screen_y = wrap_mod(g_positions[i][1], (float)g_height);
-    float x = screen_x * inv_w * 2.0f - 1.0f;
-    float y = 1.0f - screen_y * inv_h * 2.0f;
-    verts[i * 2 + 0] = x;
-    verts[i * 2 + 1] = y;
+  glUseProgram(g_program);
+  glUniform1f(g_time_loc, time_sec);
+  glUniform2f(g_world_loc, g_world_w, g_world_h);
+
+  acquire_ring_slot();
+  glBufferSubData(GL_ARRAY_BUFFER, 0, (GLsizeiptr)count * sizeof(BoidInstance), inst);
+  glBindVertexArray(g_ring_vao[g_ring_slot]);
+  glDrawArraysInstanced(GL_TRIANGLES, 0, 3, count);
+  g_ring_fence[g_ring_slot] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+}
+
+int demo_app_frame(double time_sec, double dt_sec) {
+  if (!g_active) return 0;
+  double start_ms = emscripten_get_now();
+  double tick = 1.0 / g_tick_rate;
+  g_accumulator += dt_sec > MAX_FRAME_DT ? MAX_FRAME_DT : dt_sec;
+  int steps = 0;
+  while (g_accumulator >= tick && steps < MAX_TICKS_PER_FRAME) {
+    step_simulation((float)tick);
+    g_accumulator -= tick;
+    steps++;
   }
+  if (g_accumulator >= tick) g_accumulator = fmod(g_accumulator, tick);
+  float alpha = (float)(g_accumulator / tick);
 
   glDisable(GL_DEPTH_TEST);
-  glUseProgram(g_program);
-  glUniform1f(g_time_loc, (float)time_sec);
-  if (g_resolution_loc >= 0) {
-    glUniform2f(g_resolution_loc, (float)g_width, (float)g_height);
+  // The GPU step bins into its own grid target.
+  glViewport(0, 0, g_width, g_height);
+  // The runtime's target keeps its contents between frames.
+  glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
+  glClear(GL_COLOR_BUFFER_BIT);
+  if (g_engine == ENGINE_GPU) {
+    boids_gpu_draw((float)time_sec, alpha);
+  } else {
+    draw_cpu((float)time_sec, alpha);
   }
-
-  glBindVertexArray(g_vao);
-  glBindBuffer(GL_ARRAY_BUFFER, g_vbo);
-  glBufferSubData(GL_ARRAY_BUFFER, 0, sizeof(verts), verts);
-  glDrawArrays(GL_POINTS, 0, MAX_BOIDS);
+  control_population(emscripten_get_now() - start_ms);
+  return DEMO_FRAME_DRAWN | DEMO_FRAME_AGAIN;
 }
 
 void demo_app_set_active(int active) {
   g_active = active ? 1 : 0;
 }
 
-void demo_app_update_mouse(float x, float y, int present) {
-  g_mouse_x = x;
-  g_mouse_y = y;
-  g_mouse_present = present;
-}
-
 void demo_app_shutdown(void) {
-  if (g_vbo) {
-    glDeleteBuffers(1, &g_vbo);
-    g_vbo = 0;
+  if (g_gpu_ok) {
+    boids_gpu_shutdown();
+    g_gpu_ok = 0;
   }
-  if (g_vao) {
-    glDeleteVertexArrays(1, &g_vao);
-    g_vao = 0;
+  for (int i = 0; i < INSTANCE_RING; ++i) {
+    if (g_ring_fence[i]) glDeleteSync(g_ring_fence[i]);
+    g_ring_fence[i] = 0;
   }
+  glDeleteVertexArrays(INSTANCE_RING, g_ring_vao);
+  glDeleteBuffers(INSTANCE_RING, g_ring_vbo);
+  memset(g_ring_vao, 0, sizeof g_ring_vao);
+  memset(g_ring_vbo, 0, sizeof g_ring_vbo);
+  g_ring_capacity = 0;
   if (g_program) {
     glDeleteProgram(g_program);
     g_program = 0;
   }
+  free(g_instances);
+  g_instances = NULL;
+  g_instance_capacity = 0;
+  boids_flock_free(&g_flock);
+}
+
+EMSCRIPTEN_KEEPALIVE
+int boids_get_count(void) {
+  return g_flock.count;
+}
+
+// Pins the CPU flock at `count` boids and turns the controller off until
+// the next boids_set_budget_ms.
+EMSCRIPTEN_KEEPALIVE
+void boids_set_count(int count) {
+  g_auto_count = 0;
+  apply_count(count);
+}
+
+EMSCRIPTEN_KEEPALIVE
+double boids_get_budget_ms(void) {
+  return g_budget_ms;
+}
+
+// Sets the per-frame simulation + draw budget and (re)enables the
+// controller; a budget <= 0 turns it off and keeps the current count.
+EMSCRIPTEN_KEEPALIVE
+void boids_set_budget_ms(double ms) {
+  if (ms > 0.0) {
+    g_budget_ms = ms;
+    g_auto_count = 1;
+    g_settle_frames = 0;
+  } else {
+    g_auto_count = 0;
+  }
+}
+
+// Smoothed simulation + draw time per frame, as the controller sees it.
+EMSCRIPTEN_KEEPALIVE
+double boids_get_frame_ms(void) {
+  return g_frame_cost_ms;
+}
+
+// The pointer arrives in render-target pixels.
+void demo_app_update_mouse(float x, float y, int present) {
+  g_mouse_x = x / g_pixel_ratio;
+  g_mouse_y = y / g_pixel_ratio;
+  g_mouse_present = present;
+}
+
+static void reset_engine(void) {
+  g_accumulator = 0.0;
+  if (g_engine == ENGINE_GPU) {
+    boids_gpu_reset(g_gpu_boids, g_world_w, g_world_h, boids_rng_next(&g_flock.rng));
+  } else {
+    reset_boids(g_flock.count);
+  }
+}
+
+// Restarts the active engine from a known seed, for reproducible runs.
+EMSCRIPTEN_KEEPALIVE
+void boids_set_seed(uint32_t seed) {
+  boids_rng_seed(&g_flock.rng, seed);
+  reset_engine();
+}
+
+EMSCRIPTEN_KEEPALIVE
+void boids_set_tick_rate(double hz) {
+  if (hz < 1.0) hz = 1.0;
+  if (hz > 1000.0) hz = 1000.0;
+  g_tick_rate = hz;
+  g_accumulator = 0.0;
+}
+
+EMSCRIPTEN_KEEPALIVE
+double boids_get_tick_rate(void) {
+  return g_tick_rate;
+}
+
+EMSCRIPTEN_KEEPALIVE
+int boids_set_engine(int engine) {
+  g_engine = (engine == ENGINE_GPU && g_gpu_ok) ? ENGINE_GPU : ENGINE_CPU;
+  return g_engine;
+}
+
+EMSCRIPTEN_KEEPALIVE
+int boids_get_engine(void) {
+  return g_engine;
+}
+
+EMSCRIPTEN_KEEPALIVE
+void boids_set_gpu_count(int count) {
+  g_gpu_boids = count > 0 ? count : 0;
+  if (g_gpu_ok) boids_gpu_reset(g_gpu_boids, g_world_w, g_world_h, boids_rng_next(&g_flock.rng));
+}
+
+EMSCRIPTEN_KEEPALIVE
+void boids_set_simd(int enabled) {
+  g_flock.use_simd = (enabled && boids_simd_available()) ? 1 : 0;
+}
+
+EMSCRIPTEN_KEEPALIVE
+int boids_get_simd(void) {
+  return g_flock.use_simd;
+}
+
+// Neighborhood mode of the CPU engine (BOIDS_MODE_*); returns the mode
+// applied. The GPU engine always uses its own per-cell aggregates.
+EMSCRIPTEN_KEEPALIVE
+int boids_set_mode(int mode) {
+  return boids_flock_set_mode(&g_flock, mode);
+}
+
+EMSCRIPTEN_KEEPALIVE
+int boids_get_mode(void) {
+  return g_flock.mode;
+}
+
+EMSCRIPTEN_KEEPALIVE
+float boids_set_radius(float radius) {
+  return boids_flock_set_radius(&g_flock, radius);
+}
+
+EMSCRIPTEN_KEEPALIVE
+float boids_get_radius(void) {
+  return g_flock.neighbor_radius;
+}
+
+EMSCRIPTEN_KEEPALIVE
+float boids_set_opening_angle(float theta) {
+  return boids_flock_set_opening_angle(&g_flock, theta);
+}
+
+// Neighbors per boid in kNN mode; returns the k applied.
+EMSCRIPTEN_KEEPALIVE
+int boids_set_k(int k) {
+  return boids_flock_set_k(&g_flock, k);
+}
+
+EMSCRIPTEN_KEEPALIVE
+int boids_get_k(void) {
+  return g_flock.knn_k;
 }
 
 void demo_app_handle_key(int key, int pressed) {
   switch (key) {
-    case 4: if (pressed) reset_boids(); break; // Z
+    case 4: if (pressed) reset_engine(); break; // Z
+    case 5: if (pressed) boids_set_engine(!g_engine); break; // X
+    case 6: if (pressed) boids_set_mode((g_flock.mode + 1) % BOIDS_MODE_COUNT); break; // C
     default: (void)pressed; break;
   }
 }
@@ -0,0 +1,529 @@
+#include <GLES3/gl3.h>
+#include <emscripten/html5.h>
+#include <stdio.h>
+#include <stddef.h>
+
+#include "boids_gpu.h"
+#include "boids_params.h"
+
+static int g_ready = 0;
+// World size in the flock's units (CSS pixels; see boids.c).
+static float g_world_w = 0.0f;
+static float g_world_h = 0.0f;
+static int g_count = 0;
+static int g_cur = 0;
+
+static GLuint g_state_vbo[2] = {0, 0};
+static GLuint g_state_vao[2] = {0, 0};
+static GLuint g_draw_vao[2] = {0, 0};
+static GLuint g_empty_vao = 0;
+
+static int g_grid_cols = 0;
+static int g_grid_rows = 0;
+static GLuint g_grid_fbo = 0;
+static GLuint g_grid_tex[2] = {0, 0};
+
+static GLuint g_seed_program = 0;
+static GLuint g_bin_program = 0;
+static GLuint g_step_program = 0;
+static GLuint g_draw_program = 0;
+
+static GLint g_seed_seed_loc = -1, g_seed_world_loc = -1;
+static GLint g_bin_world_loc = -1, g_bin_grid_loc = -1, g_bin_cell_loc = -1;
+static GLint g_step_pos_loc = -1, g_step_vel_loc = -1, g_step_grid_loc = -1, g_step_cell_loc = -1;
+static GLint g_step_world_loc = -1, g_step_dt_loc = -1, g_step_mouse_loc = -1, g_step_seed_loc = -1;
+static GLint g_draw_world_loc = -1, g_draw_time_loc = -1, g_draw_alpha_loc = -1;
+
+static char g_defines[512];
+
+static const char *VERSION_SRC =
+    "#version 300 es\n"
+    "precision highp float;\n"
+    "precision highp int;\n";
+
+static const char *COMMON_SRC =
+    "float wrap_distance(float delta, float extent){\n"
+    "  if (extent <= 0.0) return delta;\n"
+    "  float half_extent = extent * 0.5;\n"
+    "  if (delta > half_extent) delta -= extent;\n"
+    "  if (delta < -half_extent) delta += extent;\n"
+    "  return delta;\n"
+    "}\n"
+    "uint hash_u32(uint x){\n"
+    "  x ^= x >> 16u; x *= 0x7FEB352Du;\n"
+    "  x ^= x >> 15u; x *= 0x846CA68Bu;\n"
+    "  x ^= x >> 16u;\n"
+    "  return x;\n"
+    "}\n"
+    "float hash_unit(uint x){ return float(hash_u32(x) >> 8u) / 16777216.0; }\n";
+
+static const char *SEED_VERT_SRC =
+    "uniform uint u_seed;\n"
+    "uniform vec2 u_world;\n"
+    "out vec4 v_state;\n"
+    "void main(){\n"
+    "  uint id = uint(gl_VertexID) * 4u;\n"
+    "  vec2 p = vec2(hash_unit(u_seed ^ id), hash_unit(u_seed ^ (id + 1u))) * u_world;\n"
+    "  float angle = hash_unit(u_seed ^ (id + 2u)) * 6.2831853;\n"
+    "  float speed = 60.0 + hash_unit(u_seed ^ (id + 3u)) * 40.0;\n"
+    "  v_state = vec4(p, cos(angle) * speed, sin(angle) * speed);\n"
+    "  gl_Position = vec4(0.0, 0.0, 0.0, 1.0);\n"
+    "}\n";
+
+static const char *DISCARD_FRAG_SRC =
+    "out vec4 fragColor;\n"
+    "void main(){ fragColor = vec4(0.0); }\n";
+
+// Splats every boid into its grid cell; additive blending leaves the sum of
+// cell-relative positions, the count and the sum of velocities per cell.
+static const char *BIN_VERT_SRC =
+    "layout(location=0) in vec4 a_state;\n"
+    "uniform vec2 u_world;\n"
+    "uniform ivec2 u_grid;\n"
+    "uniform vec2 u_cell;\n"
+    "out vec4 v_pos;\n"
+    "out vec4 v_vel;\n"
+    "void main(){\n"
+    "  ivec2 c = clamp(ivec2(a_state.xy / u_cell), ivec2(0), u_grid - 1);\n"
+    "  v_pos = vec4(a_state.xy - vec2(c) * u_cell, 1.0, 0.0);\n"
+    "  v_vel = vec4(a_state.zw, 0.0, 0.0);\n"
+    "  gl_Position = vec4((vec2(c) + 0.5) / vec2(u_grid) * 2.0 - 1.0, 0.0, 1.0);\n"
+    "  gl_PointSize = 1.0;\n"
+    "}\n";
+
+static const char *BIN_FRAG_SRC =
+    "in vec4 v_pos;\n"
+    "in vec4 v_vel;\n"
+    "layout(location=0) out vec4 o_pos;\n"
+    "layout(location=1) out vec4 o_vel;\n"
+    "void main(){\n"
+    "  o_pos = v_pos;\n"
+    "  o_vel = v_vel;\n"
+    "}\n";
+
+// A cell-aggregate approximation of the CPU steering rules, not a port of
+// them: each of the 3x3 neighboring cells enters as a single boid at the
+// centroid of its members (the own cell's without this boid), weighted by
+// their count. Alignment and cohesion come out close to the per-boid sums;
+// separation only sees centroids, so individual boids in a crowded cell
+// barely push apart and the flock packs tighter than the CPU engine's.
+static const char *STEP_VERT_SRC =
+    "precision highp sampler2D;\n"
+    "layout(location=0) in vec4 a_state;\n"
+    "uniform sampler2D u_grid_pos;\n"
+    "uniform sampler2D u_grid_vel;\n"
+    "uniform ivec2 u_grid;\n"
+    "uniform vec2 u_cell;\n"
+    "uniform vec2 u_world;\n"
+    "uniform float u_dt;\n"
+    "uniform vec3 u_mouse;\n"
+    "uniform uint u_seed;\n"
+    "out vec4 v_state;\n"
+    "void main(){\n"
+    "  vec2 p = a_state.xy;\n"
+    "  vec2 v = a_state.zw;\n"
+    "  ivec2 c = clamp(ivec2(p / u_cell), ivec2(0), u_grid - 1);\n"
+    "  vec2 self_rel = p - vec2(c) * u_cell;\n"
+    "  vec2 align = vec2(0.0);\n"
+    "  vec2 cohesion = vec2(0.0);\n"
+    "  vec2 separation = vec2(0.0);\n"
+    "  float neighbors = 0.0;\n"
+    "  for (int oy = -1; oy <= 1; ++oy){\n"
+    "    if ((u_grid.y == 1 && oy != 0) || (u_grid.y == 2 && oy < 0)) continue;\n"
+    "    for (int ox = -1; ox <= 1; ++ox){\n"
+    "      if ((u_grid.x == 1 && ox != 0) || (u_grid.x == 2 && ox < 0)) continue;\n"
+    "      ivec2 cc = (c + ivec2(ox, oy) + u_grid) % u_grid;\n"
+    "      vec4 gp = texelFetch(u_grid_pos, cc, 0);\n"
+    "      vec2 sum_vel = texelFetch(u_grid_vel, cc, 0).xy;\n"
+    "      float n = gp.z;\n"
+    "      vec2 sum_rel = gp.xy;\n"
+    "      if (cc == c){ n -= 1.0; sum_rel -= self_rel; sum_vel -= v; }\n"
+    "      if (n < 0.5) continue;\n"
+    "      vec2 centroid = vec2(cc) * u_cell + sum_rel / n;\n"
+    "      vec2 d = vec2(wrap_distance(centroid.x - p.x, u_world.x),\n"
+    "                    wrap_distance(centroid.y - p.y, u_world.y));\n"
+    "      float dist2 = dot(d, d);\n"
+    "      if (dist2 >= NEIGHBOR_RADIUS * NEIGHBOR_RADIUS) continue;\n"
+    "      align += sum_vel;\n"
+    "      cohesion += (p + d) * n;\n"
+    "      neighbors += n;\n"
+    "      if (dist2 < SEPARATION_RADIUS * SEPARATION_RADIUS && dist2 > 0.0001){\n"
+    "        separation -= d / dist2 * n;\n"
+    "      }\n"
+    "    }\n"
+    "  }\n"
+    "  vec2 accel = vec2(0.0);\n"
+    "  if (neighbors > 0.0){\n"
+    "    float inv = 1.0 / neighbors;\n"
+    "    accel += (align * inv - v) * 1.2;\n"
+    "    accel += (cohesion * inv - p) * 0.008;\n"
+    "    accel += separation * 10.0;\n"
+    "  }\n"
+    "  bool mouse = u_mouse.z > 0.5;\n"
+    "  if (mouse){\n"
+    "    vec2 dm = u_mouse.xy - p;\n"
+    "    float distm2 = dot(dm, dm);\n"
+    "    if (distm2 > 25.0) accel += dm * inversesqrt(distm2) * 160.0;\n"
+    "  }\n"
+    "  vec2 lo = (EDGE_THRESHOLD - p) * (1.0 / EDGE_THRESHOLD);\n"
+    "  vec2 hi = (EDGE_THRESHOLD - (u_world - p)) * (1.0 / EDGE_THRESHOLD);\n"
+    "  if (u_world.x > 0.0){\n"
+    "    if (lo.x > 0.0) accel.x += EDGE_FORCE * lo.x;\n"
+    "    if (hi.x > 0.0) accel.x -= EDGE_FORCE * hi.x;\n"
+    "  }\n"
+    "  if (u_world.y > 0.0){\n"
+    "    if (lo.y > 0.0) accel.y += EDGE_FORCE * lo.y;\n"
+    "    if (hi.y > 0.0) accel.y -= EDGE_FORCE * hi.y;\n"
+    "  }\n"
+    "  float speed = length(v);\n"
+    "  if (speed > 0.0001) accel += v / speed * 6.0;\n"
+    "  float acc_mag = length(accel);\n"
+    "  if (acc_mag > MAX_FORCE) accel *= MAX_FORCE / acc_mag;\n"
+    "  v += accel * u_dt;\n"
+    "  float new_speed = length(v);\n"
+    "  if (new_speed > MAX_SPEED) v *= MAX_SPEED / new_speed;\n"
+    "  v *= mouse ? VELOCITY_DAMP_ACTIVE : VELOCITY_DAMP_IDLE;\n"
+    "  if (!mouse){\n"
+    "    float cruise = 80.0;\n"
+    "    float speed_after = length(v);\n"
+    "    if (speed_after < cruise){\n"
+    "      if (speed_after > 0.0001){\n"
+    "        v *= cruise / speed_after;\n"
+    "      } else {\n"
+    "        float angle = hash_unit(u_seed ^ (uint(gl_VertexID) * 0x9E3779B9u)) * 6.2831853;\n"
+    "        v = vec2(cos(angle), sin(angle)) * cruise;\n"
+    "      }\n"
+    "    }\n"
+    "  }\n"
+    "  p += v * u_dt;\n"
+    "  if (u_world.x > 0.0) p.x = mod(p.x, u_world.x);\n"
+    "  if (u_world.y > 0.0) p.y = mod(p.y, u_world.y);\n"
+    "  v_state = vec4(p, v);\n"
+    "  gl_Position = vec4(0.0, 0.0, 0.0, 1.0);\n"
+    "}\n";
+
+// Instanced straight from the feedback buffers: each boid is a triangle
+// oriented along its velocity, interpolated between the last two ticks.
+static const char *DRAW_VERT_SRC =
+    "layout(location=0) in vec4 a_state;\n"
+    "layout(location=1) in vec4 a_prev;\n"
+    "uniform vec2 u_world;\n"
+    "uniform float u_alpha;\n"
+    "const vec2 GLYPH[3] = vec2[3](vec2(7.0, 0.0), vec2(-4.0, 3.5), vec2(-4.0, -3.5));\n"
+    "void main(){\n"
+    "  vec2 d = vec2(wrap_distance(a_state.x - a_prev.x, u_world.x),\n"
+    "                wrap_distance(a_state.y - a_prev.y, u_world.y));\n"
+    "  vec2 world = max(u_world, vec2(1.0));\n"
+    "  vec2 p = mod(a_prev.xy + d * u_alpha, world);\n"
+    "  vec2 dir = dot(a_state.zw, a_state.zw) > 0.0 ? normalize(a_state.zw) : vec2(1.0, 0.0);\n"
+    "  vec2 local = GLYPH[gl_VertexID];\n"
+    "  p += vec2(local.x * dir.x - local.y * dir.y, local.x * dir.y + local.y * dir.x);\n"
+    "  vec2 clip = p / world * 2.0 - 1.0;\n"
+    "  gl_Position = vec4(clip.x, -clip.y, 0.0, 1.0);\n"
+    "}\n";
+
+static const char *DRAW_FRAG_SRC =
+    "uniform float u_time;\n"
+    "out vec4 fragColor;\n"
+    "void main(){\n"
+    "  float r = 0.6 + 0.4 * sin(u_time * 1.7 + gl_FragCoord.x * 0.02);\n"
+    "  float g = 0.6 + 0.4 * sin(u_time * 1.3 + gl_FragCoord.y * 0.02 + 1.7);\n"
+    "  float b = 0.7 + 0.3 * sin(u_time * 1.1 + 3.1);\n"
+    "  fragColor = vec4(r, g, b, 1.0);\n"
+    "}\n";
+
+static GLuint compile_shader(GLenum type, const char *body) {
+  const char *srcs[] = {VERSION_SRC, g_defines, COMMON_SRC, body};
+  GLuint shader = glCreateShader(type);
+  glShaderSource(shader, 4, srcs, NULL);
+  glCompileShader(shader);
+  GLint ok = 0;
+  glGetShaderiv(shader, GL_COMPILE_STATUS, &ok);
+  if (!ok) {
+#ifdef DEBUG
+    char log[512];
+    glGetShaderInfoLog(shader, sizeof log, NULL, log);
+    printf("boids gpu shader error: %s\n", log);
+#endif
+    glDeleteShader(shader);
+    return 0;
+  }
+  return shader;
+}
+
+// Links vs/fs; when `varying` is set it is captured with transform feedback.
+static GLuint link_program(const char *vs_src, const char *fs_src, const char *varying) {
+  GLuint vs = compile_shader(GL_VERTEX_SHADER, vs_src);
+  GLuint fs = compile_shader(GL_FRAGMENT_SHADER, fs_src);
+  if (!vs || !fs) {
+    if (vs) glDeleteShader(vs);
+    if (fs) glDeleteShader(fs);
+    return 0;
+  }
+  GLuint prog = glCreateProgram();
+  glAttachShader(prog, vs);
+  glAttachShader(prog, fs);
+  if (varying) {
+    glTransformFeedbackVaryings(prog, 1, &varying, GL_INTERLEAVED_ATTRIBS);
+  }
+  glLinkProgram(prog);
+  GLint ok = 0;
+  glGetProgramiv(prog, GL_LINK_STATUS, &ok);
+  if (!ok) {
+#ifdef DEBUG
+    char log[512];
+    glGetProgramInfoLog(prog, sizeof log, NULL, log);
+    printf("boids gpu link error: %s\n", log);
+#endif
+    glDeleteProgram(prog);
+    prog = 0;
+  }
+  glDetachShader(prog, vs);
+  glDetachShader(prog, fs);
+  glDeleteShader(vs);
+  glDeleteShader(fs);
+  return prog;
+}
+
+static void delete_grid(void) {
+  if (g_grid_fbo) {
+    glDeleteFramebuffers(1, &g_grid_fbo);
+    g_grid_fbo = 0;
+  }
+  if (g_grid_tex[0]) {
+    glDeleteTextures(2, g_grid_tex);
+    g_grid_tex[0] = g_grid_tex[1] = 0;
+  }
+}
+
+static void create_grid(void) {
+  delete_grid();
+  g_grid_cols = (int)(g_world_w / NEIGHBOR_RADIUS);
+  g_grid_rows = (int)(g_world_h / NEIGHBOR_RADIUS);
+  if (g_grid_cols < 1) g_grid_cols = 1;
+  if (g_grid_rows < 1) g_grid_rows = 1;
+
+  glGenTextures(2, g_grid_tex);
+  for (int i = 0; i < 2; ++i) {
+    glBindTexture(GL_TEXTURE_2D, g_grid_tex[i]);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA32F, g_grid_cols, g_grid_rows, 0, GL_RGBA, GL_FLOAT, NULL);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+  }
+  glBindTexture(GL_TEXTURE_2D, 0);
+
+  glGenFramebuffers(1, &g_grid_fbo);
+  glBindFramebuffer(GL_FRAMEBUFFER, g_grid_fbo);
+  glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, g_grid_tex[0], 0);
+  glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT1, GL_TEXTURE_2D, g_grid_tex[1], 0);
+  const GLenum bufs[] = {GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1};
+  glDrawBuffers(2, bufs);
+  glBindFramebuffer(GL_FRAMEBUFFER, 0);
+}
+
+int boids_gpu_init(void) {
+  EMSCRIPTEN_WEBGL_CONTEXT_HANDLE ctx = emscripten_webgl_get_current_context();
+  if (!emscripten_webgl_enable_extension(ctx, "EXT_color_buffer_float") ||
+      !emscripten_webgl_enable_extension(ctx, "EXT_float_blend")) {
+    return 0;
+  }
+
+  snprintf(g_defines, sizeof g_defines,
+           "#define NEIGHBOR_RADIUS %.4f\n"
+           "#define SEPARATION_RADIUS %.4f\n"
+           "#define MAX_SPEED %.4f\n"
+           "#define MAX_FORCE %.4f\n"
+           "#define VELOCITY_DAMP_ACTIVE %.6f\n"
+           "#define VELOCITY_DAMP_IDLE %.6f\n"
+           "#define EDGE_THRESHOLD %.4f\n"
+           "#define EDGE_FORCE %.4f\n",
+           NEIGHBOR_RADIUS, SEPARATION_RADIUS, MAX_SPEED, MAX_FORCE,
+           VELOCITY_DAMP_ACTIVE, VELOCITY_DAMP_IDLE, EDGE_THRESHOLD, EDGE_FORCE);
+
+  g_seed_program = link_program(SEED_VERT_SRC, DISCARD_FRAG_SRC, "v_state");
+  g_bin_program = link_program(BIN_VERT_SRC, BIN_FRAG_SRC, NULL);
+  g_step_program = link_program(STEP_VERT_SRC, DISCARD_FRAG_SRC, "v_state");
+  g_draw_program = link_program(DRAW_VERT_SRC, DRAW_FRAG_SRC, NULL);
+  if (!g_seed_program || !g_bin_program || !g_step_program || !g_draw_program) {
+    boids_gpu_shutdown();
+    return 0;
+  }
+
+  g_seed_seed_loc = glGetUniformLocation(g_seed_program, "u_seed");
+  g_seed_world_loc = glGetUniformLocation(g_seed_program, "u_world");
+  g_bin_world_loc = glGetUniformLocation(g_bin_program, "u_world");
+  g_bin_grid_loc = glGetUniformLocation(g_bin_program, "u_grid");
+  g_bin_cell_loc = glGetUniformLocation(g_bin_program, "u_cell");
+  g_step_pos_loc = glGetUniformLocation(g_step_program, "u_grid_pos");
+  g_step_vel_loc = glGetUniformLocation(g_step_program, "u_grid_vel");
+  g_step_grid_loc = glGetUniformLocation(g_step_program, "u_grid");
+  g_step_cell_loc = glGetUniformLocation(g_step_program, "u_cell");
+  g_step_world_loc = glGetUniformLocation(g_step_program, "u_world");
+  g_step_dt_loc = glGetUniformLocation(g_step_program, "u_dt");
+  g_step_mouse_loc = glGetUniformLocation(g_step_program, "u_mouse");
+  g_step_seed_loc = glGetUniformLocation(g_step_program, "u_seed");
+  g_draw_world_loc = glGetUniformLocation(g_draw_program, "u_world");
+  g_draw_time_loc = glGetUniformLocation(g_draw_program, "u_time");
+  g_draw_alpha_loc = glGetUniformLocation(g_draw_program, "u_alpha");
+
+  glGenBuffers(2, g_state_vbo);
+  glGenVertexArrays(2, g_state_vao);
+  for (int i = 0; i < 2; ++i) {
+    glBindVertexArray(g_state_vao[i]);
+    glBindBuffer(GL_ARRAY_BUFFER, g_state_vbo[i]);
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(0, 4, GL_FLOAT, GL_FALSE, 4 * sizeof(float), (void *)0);
+  }
+  glGenVertexArrays(2, g_draw_vao);
+  for (int i = 0; i < 2; ++i) {
+    glBindVertexArray(g_draw_vao[i]);
+    glBindBuffer(GL_ARRAY_BUFFER, g_state_vbo[i]);
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(0, 4, GL_FLOAT, GL_FALSE, 4 * sizeof(float), (void *)0);
+    glVertexAttribDivisor(0, 1);
+    glBindBuffer(GL_ARRAY_BUFFER, g_state_vbo[1 - i]);
+    glEnableVertexAttribArray(1);
+    glVertexAttribPointer(1, 4, GL_FLOAT, GL_FALSE, 4 * sizeof(float), (void *)0);
+    glVertexAttribDivisor(1, 1);
+  }
+  glGenVertexArrays(1, &g_empty_vao);
+  glBindVertexArray(0);
+  glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+  g_ready = 1;
+  return 1;
+}
+
+static void run_feedback(GLuint dst, int count) {
+  glEnable(GL_RASTERIZER_DISCARD);
+  glBindBufferBase(GL_TRANSFORM_FEEDBACK_BUFFER, 0, dst);
+  glBeginTransformFeedback(GL_POINTS);
+  glDrawArrays(GL_POINTS, 0, count);
+  glEndTransformFeedback();
+  glBindBufferBase(GL_TRANSFORM_FEEDBACK_BUFFER, 0, 0);
+  glDisable(GL_RASTERIZER_DISCARD);
+}
+
+void boids_gpu_reset(int count, float width, float height, uint32_t seed) {
+  if (!g_ready) return;
+  if (count < 0) count = 0;
+  g_count = count;
+  g_cur = 0;
+  if (width != g_world_w || height != g_world_h || !g_grid_fbo) {
+    g_world_w = width;
+    g_world_h = height;
+    create_grid();
+  }
+  for (int i = 0; i < 2; ++i) {
+    glBindBuffer(GL_ARRAY_BUFFER, g_state_vbo[i]);
+    glBufferData(GL_ARRAY_BUFFER, (GLsizeiptr)count * 4 * sizeof(float), NULL, GL_DYNAMIC_COPY);
+  }
+  glBindBuffer(GL_ARRAY_BUFFER, 0);
+  if (count == 0) return;
+
+  glUseProgram(g_seed_program);
+  glUniform1ui(g_seed_seed_loc, seed);
+  glUniform2f(g_seed_world_loc, g_world_w, g_world_h);
+  glBindVertexArray(g_empty_vao);
+  run_feedback(g_state_vbo[0], count);
+
+  // Start with previous == current so the first frames interpolate in place.
+  GLsizeiptr bytes = (GLsizeiptr)count * 4 * sizeof(float);
+  glBindBuffer(GL_COPY_READ_BUFFER, g_state_vbo[0]);
+  glBindBuffer(GL_COPY_WRITE_BUFFER, g_state_vbo[1]);
+  glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, bytes);
+  glBindBuffer(GL_COPY_READ_BUFFER, 0);
+  glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+}
+
+void boids_gpu_resize(float width, float height) {
+  g_world_w = width;
+  g_world_h = height;
+  if (g_ready) create_grid();
+}
+
+void boids_gpu_step(float dt, float mouse_x, float mouse_y, int mouse_present, uint32_t seed) {
+  if (!g_ready || g_count == 0) return;
+  float cell_w = g_world_w / g_grid_cols;
+  float cell_h = g_world_h / g_grid_rows;
+
+  glBindFramebuffer(GL_FRAMEBUFFER, g_grid_fbo);
+  glViewport(0, 0, g_grid_cols, g_grid_rows);
+  glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
+  glClear(GL_COLOR_BUFFER_BIT);
+  glEnable(GL_BLEND);
+  glBlendEquation(GL_FUNC_ADD);
+  glBlendFunc(GL_ONE, GL_ONE);
+  glUseProgram(g_bin_program);
+  glUniform2f(g_bin_world_loc, g_world_w, g_world_h);
+  glUniform2i(g_bin_grid_loc, g_grid_cols, g_grid_rows);
+  glUniform2f(g_bin_cell_loc, cell_w, cell_h);
+  glBindVertexArray(g_state_vao[g_cur]);
+  glDrawArrays(GL_POINTS, 0, g_count);
+  glDisable(GL_BLEND);
+  glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+  glUseProgram(g_step_program);
+  glActiveTexture(GL_TEXTURE0);
+  glBindTexture(GL_TEXTURE_2D, g_grid_tex[0]);
+  glActiveTexture(GL_TEXTURE1);
+  glBindTexture(GL_TEXTURE_2D, g_grid_tex[1]);
+  glUniform1i(g_step_pos_loc, 0);
+  glUniform1i(g_step_vel_loc, 1);
+  glUniform2i(g_step_grid_loc, g_grid_cols, g_grid_rows);
+  glUniform2f(g_step_cell_loc, cell_w, cell_h);
+  glUniform2f(g_step_world_loc, g_world_w, g_world_h);
+  glUniform1f(g_step_dt_loc, dt);
+  glUniform3f(g_step_mouse_loc, mouse_x, mouse_y, mouse_present ? 1.0f : 0.0f);
+  glUniform1ui(g_step_seed_loc, seed);
+  run_feedback(g_state_vbo[1 - g_cur], g_count);
+  glBindTexture(GL_TEXTURE_2D, 0);
+  glActiveTexture(GL_TEXTURE0);
+  glBindTexture(GL_TEXTURE_2D, 0);
+  g_cur = 1 - g_cur;
+}
+
+void boids_gpu_draw(float time_sec, float alpha) {
+  if (!g_ready || g_count == 0) return;
+  glUseProgram(g_draw_program);
+  glUniform2f(g_draw_world_loc, g_world_w, g_world_h);
+  glUniform1f(g_draw_time_loc, time_sec);
+  glUniform1f(g_draw_alpha_loc, alpha);
+  glBindVertexArray(g_draw_vao[g_cur]);
+  glDrawArraysInstanced(GL_TRIANGLES, 0, 3, g_count);
+}
+
+int boids_gpu_count(void) {
+  return g_count;
+}
+
+void boids_gpu_shutdown(void) {
+  delete_grid();
+  if (g_state_vao[0]) {
+    glDeleteVertexArrays(2, g_state_vao);
+    g_state_vao[0] = g_state_vao[1] = 0;
+  }
+  if (g_draw_vao[0]) {
+    glDeleteVertexArrays(2, g_draw_vao);
+    g_draw_vao[0] = g_draw_vao[1] = 0;
+  }
+  if (g_state_vbo[0]) {
+    glDeleteBuffers(2, g_state_vbo);
+    g_state_vbo[0] = g_state_vbo[1] = 0;
+  }
+  if (g_empty_vao) {
+    glDeleteVertexArrays(1, &g_empty_vao);
+    g_empty_vao = 0;
+  }
+  GLuint *programs[] = {&g_seed_program, &g_bin_program, &g_step_program, &g_draw_program};
+  for (size_t i = 0; i < sizeof programs / sizeof programs[0]; ++i) {
+    if (*programs[i]) {
+      glDeleteProgram(*programs[i]);
+      *programs[i] = 0;
+    }
+  }
+  g_ready = 0;
+  g_count = 0;
+}
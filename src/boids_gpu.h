@@ -0,0 +1,23 @@
+#ifndef BOIDS_GPU_H
+#define BOIDS_GPU_H
+
+#include <stdint.h>
+
+// GPU-resident boids engine. State lives in two vertex buffers that are
+// advanced with transform feedback; neighbor terms are approximated from a
+// per-cell aggregate grid rendered each step (cell centroids, not
+// individual boids), so the CPU only feeds inputs.
+
+// Returns 0 when the context lacks float render targets or float blending.
+int boids_gpu_init(void);
+// The world is width x height flock units; boids_gpu_step leaves the
+// viewport on the grid target, so the caller sets its own before drawing.
+void boids_gpu_reset(int count, float width, float height, uint32_t seed);
+void boids_gpu_resize(float width, float height);
+void boids_gpu_step(float dt, float mouse_x, float mouse_y, int mouse_present, uint32_t seed);
+// alpha blends from the previous tick (0) to the latest one (1).
+void boids_gpu_draw(float time_sec, float alpha);
+int boids_gpu_count(void);
+void boids_gpu_shutdown(void);
+
+#endif /* BOIDS_GPU_H */
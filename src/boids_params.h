@@ -0,0 +1,14 @@
+#ifndef BOIDS_PARAMS_H
+#define BOIDS_PARAMS_H
+
+// Flocking constants shared by the CPU and GPU boids engines.
+#define NEIGHBOR_RADIUS 80.0f
+#define SEPARATION_RADIUS 70.0f
+#define MAX_SPEED 400.0f
+#define MAX_FORCE 200.0f
+#define VELOCITY_DAMP_ACTIVE 0.985f
+#define VELOCITY_DAMP_IDLE 0.9f
+#define EDGE_THRESHOLD 60.0f
+#define EDGE_FORCE 800.0f
+
+#endif /* BOIDS_PARAMS_H */
@@ -0,0 +1,895 @@
+#include <math.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#if defined(__wasm_simd128__) && !defined(BOIDS_NO_SIMD)
+#include <wasm_simd128.h>
+#define BOIDS_SIMD 1
+#else
+#define BOIDS_SIMD 0
+#endif
+
+#include "boids_params.h"
+#include "boids_sim.h"
+#include "workpool.h"
+
+// Slack after the last boid so vector loads may run past the end of a cell.
+#define SIMD_PAD 4
+#define STEP_CHUNK 512
+#define MIN_RADIUS 8.0f
+#define MAX_RADIUS 1000.0f
+#define DEFAULT_OPENING_ANGLE 0.6f
+// Far-field cells outside the near block with at most this many boids are
+// scanned exactly instead of being taken as an aggregate.
+#define FAR_EXACT_CELL 16
+// Near-block cells with more boids than this are sampled with a stride, so
+// a flock crowded into one cell still costs a bounded amount per boid.
+#define FAR_DENSE_CELL 64
+#define FAR_STACK (3 * BOIDS_MAX_LEVELS + 4)
+#define DEFAULT_KNN_K 7
+// kNN mode grids the world this many times finer than the radius and
+// searches outward ring by ring, so crowded boids find their k nearest in
+// the first ring or two.
+#define KNN_SUBDIV 4
+// It looks at no more than this many candidates per boid, which caps the
+// cost when the whole flock shares a few fine cells.
+#define KNN_MAX_CANDIDATES 96
+
+typedef struct {
+  float align_x, align_y;
+  float cohesion_x, cohesion_y;
+  float separation_x, separation_y;
+  int neighbors;
+} Steering;
+
+typedef struct {
+  const BoidsFlock *flock;
+  float dt;
+  float mouse_x, mouse_y;
+  int mouse_present;
+  uint32_t seed;
+} StepParams;
+
+void boids_rng_seed(BoidsRng *rng, uint32_t seed) {
+  rng->state = seed;
+}
+
+uint32_t boids_rng_next(BoidsRng *rng) {
+  rng->state = rng->state * 1664525u + 1013904223u;
+  return rng->state;
+}
+
+float boids_rng_unit(BoidsRng *rng) {
+  return (float)((boids_rng_next(rng) >> 8) & 0xFFFFFFu) / (float)0x1000000u;
+}
+
+// Stateless per-boid random number, safe to call from worker threads.
+static float hash_unit(uint32_t x) {
+  x ^= x >> 16;
+  x *= 0x7FEB352Du;
+  x ^= x >> 15;
+  x *= 0x846CA68Bu;
+  x ^= x >> 16;
+  return (float)(x >> 8) / (float)0x1000000u;
+}
+
+int boids_simd_available(void) {
+  return BOIDS_SIMD;
+}
+
+void boids_flock_init(BoidsFlock *flock, float width, float height, uint32_t seed) {
+  memset(flock, 0, sizeof *flock);
+  flock->width = width;
+  flock->height = height;
+  flock->use_simd = BOIDS_SIMD;
+  flock->mode = BOIDS_MODE_GRID;
+  flock->neighbor_radius = NEIGHBOR_RADIUS;
+  flock->opening_angle = DEFAULT_OPENING_ANGLE;
+  flock->knn_k = DEFAULT_KNN_K;
+  boids_rng_seed(&flock->rng, seed);
+}
+
+void boids_flock_free(BoidsFlock *flock) {
+  float *arrays[] = {
+      flock->cur.x, flock->cur.y, flock->cur.vx, flock->cur.vy,
+      flock->prev.x, flock->prev.y, flock->prev.vx, flock->prev.vy,
+  };
+  for (size_t a = 0; a < sizeof arrays / sizeof arrays[0]; ++a) free(arrays[a]);
+  free(flock->cell_of);
+  free(flock->cell_start);
+  free(flock->cell_cursor);
+  free(flock->far_cells);
+  memset(&flock->cur, 0, sizeof flock->cur);
+  memset(&flock->prev, 0, sizeof flock->prev);
+  flock->cell_of = NULL;
+  flock->cell_start = NULL;
+  flock->cell_cursor = NULL;
+  flock->far_cells = NULL;
+  flock->count = 0;
+  flock->capacity = 0;
+  flock->cell_capacity = 0;
+  flock->far_capacity = 0;
+  flock->far_levels = 0;
+}
+
+int boids_flock_reserve(BoidsFlock *flock, int count) {
+  if (count <= flock->capacity) return 1;
+  int cap = flock->capacity > 0 ? flock->capacity : 256;
+  while (cap < count) cap *= 2;
+  float **arrays[] = {
+      &flock->cur.x, &flock->cur.y, &flock->cur.vx, &flock->cur.vy,
+      &flock->prev.x, &flock->prev.y, &flock->prev.vx, &flock->prev.vy,
+  };
+  int ok = 1;
+  for (size_t a = 0; a < sizeof arrays / sizeof arrays[0]; ++a) {
+    float *p = realloc(*arrays[a], (size_t)(cap + SIMD_PAD) * sizeof(float));
+    if (!p) {
+      ok = 0;
+      continue;
+    }
+    // Zero the new tail, padding included, so vector loads past the end
+    // of a cell only ever see finite values.
+    size_t old = flock->capacity > 0 ? (size_t)flock->capacity : 0;
+    memset(p + old, 0, ((size_t)cap + SIMD_PAD - old) * sizeof(float));
+    *arrays[a] = p;
+  }
+  int *cells = realloc(flock->cell_of, (size_t)cap * sizeof *cells);
+  if (cells) flock->cell_of = cells;
+  if (!ok || !cells) return 0;
+  flock->capacity = cap;
+  return 1;
+}
+
+// Scatters boids [begin, end) over the world with random headings, in both
+// buffers so they interpolate in place on their first frame.
+static void scatter(BoidsFlock *flock, int begin, int end) {
+  BoidsRng *rng = &flock->rng;
+  for (int i = begin; i < end; ++i) {
+    flock->cur.x[i] = boids_rng_unit(rng) * flock->width;
+    flock->cur.y[i] = boids_rng_unit(rng) * flock->height;
+    float angle = boids_rng_unit(rng) * 6.2831853f;
+    float speed = 60.0f + boids_rng_unit(rng) * 40.0f;
+    flock->cur.vx[i] = cosf(angle) * speed;
+    flock->cur.vy[i] = sinf(angle) * speed;
+  }
+  size_t bytes = (size_t)(end - begin) * sizeof(float);
+  if (end > begin) {
+    memcpy(flock->prev.x + begin, flock->cur.x + begin, bytes);
+    memcpy(flock->prev.y + begin, flock->cur.y + begin, bytes);
+    memcpy(flock->prev.vx + begin, flock->cur.vx + begin, bytes);
+    memcpy(flock->prev.vy + begin, flock->cur.vy + begin, bytes);
+  }
+}
+
+int boids_flock_reset(BoidsFlock *flock, int count) {
+  if (count < 0) count = 0;
+  if (!boids_flock_reserve(flock, count)) count = flock->capacity;
+  flock->count = count;
+  scatter(flock, 0, count);
+  return count;
+}
+
+// Keeps `keep` of the first `count` boids, evenly strided through the
+// arrays. Each step leaves them sorted by cell, so a stride thins every
+// region alike where dropping the tail would empty the bottom rows.
+static void retire_strided(BoidsFlock *flock, int count, int keep) {
+  float *arrays[] = {
+      flock->cur.x, flock->cur.y, flock->cur.vx, flock->cur.vy,
+      flock->prev.x, flock->prev.y, flock->prev.vx, flock->prev.vy,
+  };
+  int out = 0;
+  for (int i = 0; i < count && out < keep; ++i) {
+    // Boid i survives when it crosses the next multiple of count / keep.
+    if ((int)((int64_t)(i + 1) * keep / count) == out) continue;
+    for (size_t a = 0; a < sizeof arrays / sizeof arrays[0]; ++a) arrays[a][out] = arrays[a][i];
+    out++;
+  }
+}
+
+int boids_flock_set_count(BoidsFlock *flock, int count) {
+  if (count < 0) count = 0;
+  if (count > flock->count) {
+    if (!boids_flock_reserve(flock, count)) count = flock->capacity;
+    scatter(flock, flock->count, count);
+  } else if (count < flock->count) {
+    retire_strided(flock, flock->count, count);
+  }
+  flock->count = count;
+  return count;
+}
+
+void boids_flock_resize(BoidsFlock *flock, float width, float height) {
+  flock->width = width;
+  flock->height = height;
+}
+
+int boids_flock_set_mode(BoidsFlock *flock, int mode) {
+  flock->mode = (mode >= 0 && mode < BOIDS_MODE_COUNT) ? mode : BOIDS_MODE_GRID;
+  return flock->mode;
+}
+
+float boids_flock_set_radius(BoidsFlock *flock, float radius) {
+  if (!(radius >= MIN_RADIUS)) radius = MIN_RADIUS;
+  if (radius > MAX_RADIUS) radius = MAX_RADIUS;
+  flock->neighbor_radius = radius;
+  return radius;
+}
+
+float boids_flock_set_opening_angle(BoidsFlock *flock, float theta) {
+  if (!(theta >= 0.0f)) theta = 0.0f;
+  if (theta > 2.0f) theta = 2.0f;
+  flock->opening_angle = theta;
+  return theta;
+}
+
+int boids_flock_set_k(BoidsFlock *flock, int k) {
+  if (k < 1) k = 1;
+  if (k > BOIDS_MAX_K) k = BOIDS_MAX_K;
+  flock->knn_k = k;
+  return k;
+}
+
+static int ensure_cell_capacity(BoidsFlock *f, int cells) {
+  if (cells + 1 <= f->cell_capacity) return 1;
+  int cap = cells + 1;
+  int *start = realloc(f->cell_start, (size_t)cap * sizeof *start);
+  if (start) f->cell_start = start;
+  int *cursor = realloc(f->cell_cursor, (size_t)cap * sizeof *cursor);
+  if (cursor) f->cell_cursor = cursor;
+  if (!start || !cursor) return 0;
+  f->cell_capacity = cap;
+  return 1;
+}
+
+static int cell_coord(float value, float cell_size, int cells) {
+  if (cell_size <= 0.0f) return 0;
+  int c = (int)(value / cell_size);
+  if (c < 0) c = 0;
+  if (c >= cells) c = cells - 1;
+  return c;
+}
+
+// Neighboring rows/columns of cell c on a torus of n cells, without
+// visiting the same cell twice when the grid is narrower than 3 cells.
+static int grid_span(int c, int n, int out[3]) {
+  if (n >= 3) {
+    out[0] = (c + n - 1) % n;
+    out[1] = c;
+    out[2] = (c + 1) % n;
+    return 3;
+  }
+  for (int i = 0; i < n; ++i) out[i] = i;
+  return n;
+}
+
+// Counting sort of cur into prev by grid cell. Positions are folded back
+// onto the torus on the way, which keeps each wrap to a single correction.
+// Falls back to a single cell when the grid cannot grow; returns 0 when
+// there is not even room for that.
+static int sort_by_cell(BoidsFlock *f) {
+  float cell = f->neighbor_radius;
+  if (f->mode == BOIDS_MODE_FARFIELD && cell > SEPARATION_RADIUS) cell = SEPARATION_RADIUS;
+  if (f->mode == BOIDS_MODE_KNN) {
+    cell /= KNN_SUBDIV;
+    if (cell < MIN_RADIUS) cell = MIN_RADIUS;
+  }
+  int cols = (int)(f->width / cell);
+  int rows = (int)(f->height / cell);
+  if (cols < 1) cols = 1;
+  if (rows < 1) rows = 1;
+  if (!ensure_cell_capacity(f, cols * rows)) {
+    if (f->cell_capacity < 2) return 0;
+    cols = rows = 1;
+  }
+  int cells = cols * rows;
+  f->grid_cols = cols;
+  f->grid_rows = rows;
+  f->cell_w = f->width / cols;
+  f->cell_h = f->height / rows;
+
+  BoidArrays *src = &f->cur;
+  BoidArrays *dst = &f->prev;
+  memset(f->cell_start, 0, (size_t)(cells + 1) * sizeof *f->cell_start);
+  for (int i = 0; i < f->count; ++i) {
+    float x = boids_wrap_mod(src->x[i], f->width);
+    float y = boids_wrap_mod(src->y[i], f->height);
+    src->x[i] = x;
+    src->y[i] = y;
+    int cell = cell_coord(y, f->cell_h, rows) * cols + cell_coord(x, f->cell_w, cols);
+    f->cell_of[i] = cell;
+    f->cell_start[cell + 1]++;
+  }
+  for (int c = 0; c < cells; ++c) {
+    f->cell_start[c + 1] += f->cell_start[c];
+    f->cell_cursor[c] = f->cell_start[c];
+  }
+  for (int i = 0; i < f->count; ++i) {
+    int d = f->cell_cursor[f->cell_of[i]]++;
+    dst->x[d] = src->x[i];
+    dst->y[d] = src->y[i];
+    dst->vx[d] = src->vx[i];
+    dst->vy[d] = src->vy[i];
+  }
+  return 1;
+}
+
+// Rebuilds the far-field pyramid from the sorted grid. Level 0 sums each
+// cell's run of boids (in double, so crowded cells keep their centroid);
+// every level above adds up 2x2 blocks of the one below.
+static void build_pyramid(BoidsFlock *f) {
+  int levels = 0, total = 0;
+  int cols = f->grid_cols, rows = f->grid_rows;
+  for (;;) {
+    f->far_cols[levels] = cols;
+    f->far_rows[levels] = rows;
+    f->far_base[levels] = total;
+    total += cols * rows;
+    levels++;
+    if ((cols == 1 && rows == 1) || levels == BOIDS_MAX_LEVELS) break;
+    cols = (cols + 1) / 2;
+    rows = (rows + 1) / 2;
+  }
+  if (total > f->far_capacity) {
+    BoidsCellSum *cells = realloc(f->far_cells, (size_t)total * sizeof *cells);
+    if (!cells) {
+      f->far_levels = 0;
+      return;
+    }
+    f->far_cells = cells;
+    f->far_capacity = total;
+  }
+  f->far_levels = levels;
+
+  const BoidArrays *src = &f->prev;
+  BoidsCellSum *base = f->far_cells;
+  for (int c = 0; c < f->grid_cols * f->grid_rows; ++c) {
+    double sx = 0.0, sy = 0.0, svx = 0.0, svy = 0.0;
+    for (int j = f->cell_start[c]; j < f->cell_start[c + 1]; ++j) {
+      sx += src->x[j];
+      sy += src->y[j];
+      svx += src->vx[j];
+      svy += src->vy[j];
+    }
+    base[c].count = (float)(f->cell_start[c + 1] - f->cell_start[c]);
+    base[c].sum_x = (float)sx;
+    base[c].sum_y = (float)sy;
+    base[c].sum_vx = (float)svx;
+    base[c].sum_vy = (float)svy;
+  }
+  for (int l = 1; l < levels; ++l) {
+    const BoidsCellSum *below = f->far_cells + f->far_base[l - 1];
+    BoidsCellSum *level = f->far_cells + f->far_base[l];
+    int below_cols = f->far_cols[l - 1], below_rows = f->far_rows[l - 1];
+    for (int y = 0; y < f->far_rows[l]; ++y) {
+      for (int x = 0; x < f->far_cols[l]; ++x) {
+        BoidsCellSum sum = {0};
+        for (int cy = 2 * y; cy < 2 * y + 2 && cy < below_rows; ++cy) {
+          for (int cx = 2 * x; cx < 2 * x + 2 && cx < below_cols; ++cx) {
+            const BoidsCellSum *c = &below[cy * below_cols + cx];
+            sum.count += c->count;
+            sum.sum_x += c->sum_x;
+            sum.sum_y += c->sum_y;
+            sum.sum_vx += c->sum_vx;
+            sum.sum_vy += c->sum_vy;
+          }
+        }
+        level[y * f->far_cols[l] + x] = sum;
+      }
+    }
+  }
+}
+
+// Reference kernel: accumulates alignment, cohesion and separation terms
+// for boid i over the boids in [begin, end).
+static void accumulate_scalar(const BoidsFlock *f, Steering *st, int i, float px, float py, int begin, int end) {
+  const BoidArrays *src = &f->prev;
+  const float radius2 = f->neighbor_radius * f->neighbor_radius;
+  for (int j = begin; j < end; ++j) {
+    if (i == j) continue;
+    float dx = boids_wrap_distance(src->x[j] - px, f->width);
+    float dy = boids_wrap_distance(src->y[j] - py, f->height);
+
+    float dist2 = dx * dx + dy * dy;
+    if (dist2 < radius2) {
+      st->align_x += src->vx[j];
+      st->align_y += src->vy[j];
+      st->cohesion_x += px + dx;
+      st->cohesion_y += py + dy;
+      if (dist2 < SEPARATION_RADIUS * SEPARATION_RADIUS && dist2 > 0.0001f) {
+        st->separation_x -= dx / dist2;
+        st->separation_y -= dy / dist2;
+      }
+      st->neighbors++;
+    }
+  }
+}
+
+#if BOIDS_SIMD
+static float hsum_f32x4(v128_t v) {
+  return wasm_f32x4_extract_lane(v, 0) + wasm_f32x4_extract_lane(v, 1) +
+         wasm_f32x4_extract_lane(v, 2) + wasm_f32x4_extract_lane(v, 3);
+}
+
+// Same terms as accumulate_scalar, four neighbors per iteration. The radius
+// tests, self test and the tail of the range become lane masks, and the
+// torus wrap is a masked +/- extent (positions are folded by sort_by_cell,
+// so one correction matches wrap_distance).
+static void accumulate_simd(const BoidsFlock *f, Steering *st, int i, float px, float py, int begin, int end) {
+  const BoidArrays *src = &f->prev;
+  const v128_t vpx = wasm_f32x4_splat(px);
+  const v128_t vpy = wasm_f32x4_splat(py);
+  const v128_t ext_x = wasm_f32x4_splat(f->width);
+  const v128_t ext_y = wasm_f32x4_splat(f->height);
+  const v128_t half_x = wasm_f32x4_splat(f->width * 0.5f);
+  const v128_t half_y = wasm_f32x4_splat(f->height * 0.5f);
+  const v128_t nhalf_x = wasm_f32x4_neg(half_x);
+  const v128_t nhalf_y = wasm_f32x4_neg(half_y);
+  const v128_t radius2 = wasm_f32x4_splat(f->neighbor_radius * f->neighbor_radius);
+  const v128_t sep2 = wasm_f32x4_splat(SEPARATION_RADIUS * SEPARATION_RADIUS);
+  const v128_t min2 = wasm_f32x4_splat(0.0001f);
+  const v128_t one = wasm_f32x4_splat(1.0f);
+  const v128_t self = wasm_i32x4_splat(i);
+  const v128_t last = wasm_i32x4_splat(end);
+  v128_t lane = wasm_i32x4_make(begin, begin + 1, begin + 2, begin + 3);
+  const v128_t step = wasm_i32x4_splat(4);
+
+  v128_t ax = wasm_f32x4_splat(0.0f), ay = ax;
+  v128_t cx = ax, cy = ax;
+  v128_t sx = ax, sy = ax;
+  v128_t count = wasm_i32x4_splat(0);
+
+  for (int j = begin; j < end; j += 4) {
+    v128_t dx = wasm_f32x4_sub(wasm_v128_load(src->x + j), vpx);
+    v128_t dy = wasm_f32x4_sub(wasm_v128_load(src->y + j), vpy);
+    dx = wasm_f32x4_sub(dx, wasm_v128_and(wasm_f32x4_gt(dx, half_x), ext_x));
+    dx = wasm_f32x4_add(dx, wasm_v128_and(wasm_f32x4_lt(dx, nhalf_x), ext_x));
+    dy = wasm_f32x4_sub(dy, wasm_v128_and(wasm_f32x4_gt(dy, half_y), ext_y));
+    dy = wasm_f32x4_add(dy, wasm_v128_and(wasm_f32x4_lt(dy, nhalf_y), ext_y));
+
+    v128_t dist2 = wasm_f32x4_add(wasm_f32x4_mul(dx, dx), wasm_f32x4_mul(dy, dy));
+    v128_t valid = wasm_v128_and(wasm_i32x4_ne(lane, self), wasm_i32x4_lt(lane, last));
+    v128_t near = wasm_v128_and(valid, wasm_f32x4_lt(dist2, radius2));
+    v128_t close = wasm_v128_and(near, wasm_v128_and(wasm_f32x4_lt(dist2, sep2), wasm_f32x4_gt(dist2, min2)));
+
+    ax = wasm_f32x4_add(ax, wasm_v128_and(wasm_v128_load(src->vx + j), near));
+    ay = wasm_f32x4_add(ay, wasm_v128_and(wasm_v128_load(src->vy + j), near));
+    cx = wasm_f32x4_add(cx, wasm_v128_and(wasm_f32x4_add(vpx, dx), near));
+    cy = wasm_f32x4_add(cy, wasm_v128_and(wasm_f32x4_add(vpy, dy), near));
+    v128_t inv = wasm_f32x4_div(one, dist2);
+    sx = wasm_f32x4_sub(sx, wasm_v128_and(wasm_f32x4_mul(dx, inv), close));
+    sy = wasm_f32x4_sub(sy, wasm_v128_and(wasm_f32x4_mul(dy, inv), close));
+    count = wasm_i32x4_sub(count, near);
+    lane = wasm_i32x4_add(lane, step);
+  }
+
+  st->align_x += hsum_f32x4(ax);
+  st->align_y += hsum_f32x4(ay);
+  st->cohesion_x += hsum_f32x4(cx);
+  st->cohesion_y += hsum_f32x4(cy);
+  st->separation_x += hsum_f32x4(sx);
+  st->separation_y += hsum_f32x4(sy);
+  st->neighbors += wasm_i32x4_extract_lane(count, 0) + wasm_i32x4_extract_lane(count, 1) +
+                   wasm_i32x4_extract_lane(count, 2) + wasm_i32x4_extract_lane(count, 3);
+}
+#endif
+
+static void accumulate_range(const BoidsFlock *f, Steering *st, int i, float px, float py, int begin, int end) {
+#if BOIDS_SIMD
+  if (f->use_simd) {
+    accumulate_simd(f, st, i, px, py, begin, end);
+    return;
+  }
+#endif
+  accumulate_scalar(f, st, i, px, py, begin, end);
+}
+
+// Estimate for an overcrowded cell: every stride-th boid, weighted by the
+// stride, so the cost stays at about FAR_DENSE_CELL boids per cell.
+static void accumulate_sampled(const BoidsFlock *f, Steering *st, int i, float px, float py, int begin, int end) {
+  const BoidArrays *src = &f->prev;
+  const float radius2 = f->neighbor_radius * f->neighbor_radius;
+  int stride = (end - begin + FAR_DENSE_CELL - 1) / FAR_DENSE_CELL;
+  float w = (float)stride;
+  // Start at a boid-dependent offset so neighbors do not all sample the
+  // same subset.
+  for (int j = begin + i % stride; j < end; j += stride) {
+    if (i == j) continue;
+    float dx = boids_wrap_distance(src->x[j] - px, f->width);
+    float dy = boids_wrap_distance(src->y[j] - py, f->height);
+    float dist2 = dx * dx + dy * dy;
+    if (dist2 < radius2) {
+      st->align_x += src->vx[j] * w;
+      st->align_y += src->vy[j] * w;
+      st->cohesion_x += (px + dx) * w;
+      st->cohesion_y += (py + dy) * w;
+      if (dist2 < SEPARATION_RADIUS * SEPARATION_RADIUS && dist2 > 0.0001f) {
+        st->separation_x -= dx / dist2 * w;
+        st->separation_y -= dy / dist2 * w;
+      }
+      st->neighbors += stride;
+    }
+  }
+}
+
+static int span_hits(const int *span, int n, int lo, int hi) {
+  for (int k = 0; k < n; ++k) {
+    if (span[k] >= lo && span[k] < hi) return 1;
+  }
+  return 0;
+}
+
+// Far-field terms for boid i: walks the pyramid from the top, skipping
+// cells beyond the radius and the near block (already summed exactly).
+// A cell that is small enough for its distance contributes its count,
+// centroid and velocity sum as a whole; otherwise its children are
+// visited. Sparse fine cells are cheap enough to scan exactly.
+static void accumulate_far(const BoidsFlock *f, Steering *st, int i, float px, float py,
+                           const int *near_x, int nx, const int *near_y, int ny) {
+  const float radius2 = f->neighbor_radius * f->neighbor_radius;
+  const float theta2 = f->opening_angle * f->opening_angle;
+  int stack[FAR_STACK][3];
+  int top = 0;
+  int l_top = f->far_levels - 1;
+  for (int y = 0; y < f->far_rows[l_top]; ++y) {
+    for (int x = 0; x < f->far_cols[l_top] && top < FAR_STACK; ++x) {
+      stack[top][0] = l_top;
+      stack[top][1] = x;
+      stack[top][2] = y;
+      top++;
+    }
+  }
+
+  while (top > 0) {
+    top--;
+    int l = stack[top][0], x = stack[top][1], y = stack[top][2];
+    const BoidsCellSum *c = &f->far_cells[f->far_base[l] + y * f->far_cols[l] + x];
+    if (c->count <= 0.0f) continue;
+
+    // Covered fine cells, and the distance from the boid to the cell box.
+    int c0 = x << l, r0 = y << l;
+    int c1 = (x + 1) << l, r1 = (y + 1) << l;
+    if (c1 > f->grid_cols) c1 = f->grid_cols;
+    if (r1 > f->grid_rows) r1 = f->grid_rows;
+    float half_w = (float)(c1 - c0) * f->cell_w * 0.5f;
+    float half_h = (float)(r1 - r0) * f->cell_h * 0.5f;
+    float gap_x = fabsf(boids_wrap_distance((float)c0 * f->cell_w + half_w - px, f->width)) - half_w;
+    float gap_y = fabsf(boids_wrap_distance((float)r0 * f->cell_h + half_h - py, f->height)) - half_h;
+    if (gap_x < 0.0f) gap_x = 0.0f;
+    if (gap_y < 0.0f) gap_y = 0.0f;
+    if (gap_x * gap_x + gap_y * gap_y >= radius2) continue;
+
+    if (span_hits(near_x, nx, c0, c1) && span_hits(near_y, ny, r0, r1)) {
+      if (l == 0) continue;
+    } else {
+      float inv = 1.0f / c->count;
+      float dx = boids_wrap_distance(c->sum_x * inv - px, f->width);
+      float dy = boids_wrap_distance(c->sum_y * inv - py, f->height);
+      float dist2 = dx * dx + dy * dy;
+      float size = 2.0f * (half_w > half_h ? half_w : half_h);
+      if (l == 0 && c->count <= FAR_EXACT_CELL) {
+        int cell = r0 * f->grid_cols + c0;
+        accumulate_range(f, st, i, px, py, f->cell_start[cell], f->cell_start[cell + 1]);
+        continue;
+      }
+      if (l == 0 || size * size < theta2 * dist2) {
+        if (dist2 < radius2) {
+          st->align_x += c->sum_vx;
+          st->align_y += c->sum_vy;
+          st->cohesion_x += (px + dx) * c->count;
+          st->cohesion_y += (py + dy) * c->count;
+          st->neighbors += (int)c->count;
+        }
+        continue;
+      }
+    }
+
+    int below_cols = f->far_cols[l - 1], below_rows = f->far_rows[l - 1];
+    for (int cy = 2 * y; cy < 2 * y + 2 && cy < below_rows; ++cy) {
+      for (int cx = 2 * x; cx < 2 * x + 2 && cx < below_cols; ++cx) {
+        if (top == FAR_STACK) break;
+        stack[top][0] = l - 1;
+        stack[top][1] = cx;
+        stack[top][2] = cy;
+        top++;
+      }
+    }
+  }
+}
+
+// Max-heap on squared distance holding the k nearest candidates so far.
+typedef struct {
+  int size;
+  float dist2[BOIDS_MAX_K];
+  int index[BOIDS_MAX_K];
+} NearestHeap;
+
+static void heap_offer(NearestHeap *h, int k, float dist2, int index) {
+  int n;
+  if (h->size < k) {
+    // Sift up from the new leaf.
+    n = h->size++;
+    while (n > 0) {
+      int parent = (n - 1) / 2;
+      if (h->dist2[parent] >= dist2) break;
+      h->dist2[n] = h->dist2[parent];
+      h->index[n] = h->index[parent];
+      n = parent;
+    }
+  } else {
+    if (dist2 >= h->dist2[0]) return;
+    // Replace the farthest and sift down.
+    n = 0;
+    for (;;) {
+      int child = 2 * n + 1;
+      if (child >= h->size) break;
+      if (child + 1 < h->size && h->dist2[child + 1] > h->dist2[child]) child++;
+      if (h->dist2[child] <= dist2) break;
+      h->dist2[n] = h->dist2[child];
+      h->index[n] = h->index[child];
+      n = child;
+    }
+  }
+  h->dist2[n] = dist2;
+  h->index[n] = index;
+}
+
+// Scans cell [begin, end) into the heap, at most *budget boids of it. A
+// cell with more than that contributes a window around this boid's own
+// slot, otherwise its start: approximate, but only within one fine cell.
+static void knn_scan_cell(const BoidsFlock *f, NearestHeap *heap, int i, float px, float py,
+                          int begin, int end, int *budget) {
+  const BoidArrays *src = &f->prev;
+  const float radius2 = f->neighbor_radius * f->neighbor_radius;
+  if (end - begin > *budget) {
+    int start = (i >= begin && i < end) ? i - *budget / 2 : begin;
+    if (start < begin) start = begin;
+    if (start + *budget > end) start = end - *budget;
+    begin = start;
+    end = start + *budget;
+  }
+  *budget -= end - begin;
+  for (int j = begin; j < end; ++j) {
+    if (j == i) continue;
+    float dx = boids_wrap_distance(src->x[j] - px, f->width);
+    float dy = boids_wrap_distance(src->y[j] - py, f->height);
+    float dist2 = dx * dx + dy * dy;
+    if (dist2 < radius2) heap_offer(heap, f->knn_k, dist2, j);
+  }
+}
+
+// Topological neighborhood: the k nearest boids within the radius. Rings
+// of fine cells are scanned outward from the boid's own cell; once ring r
+// is done, every boid left is at least r cells away, so the search stops
+// as soon as the heap holds k boids nearer than that.
+static void accumulate_knn(const BoidsFlock *f, Steering *st, int i, float px, float py) {
+  const BoidArrays *src = &f->prev;
+  const int k = f->knn_k;
+  const int cols = f->grid_cols, rows = f->grid_rows;
+  const int ox = cell_coord(px, f->cell_w, cols), oy = cell_coord(py, f->cell_h, rows);
+  const float cell = f->cell_w < f->cell_h ? f->cell_w : f->cell_h;
+  // Offsets that reach distinct cells on the torus.
+  const int lo_x = -(cols - 1) / 2, hi_x = cols / 2;
+  const int lo_y = -(rows - 1) / 2, hi_y = rows / 2;
+  const int max_ring = (int)ceilf(f->neighbor_radius / cell);
+
+  NearestHeap heap;
+  heap.size = 0;
+  int budget = KNN_MAX_CANDIDATES;
+  for (int ring = 0; ring <= max_ring && budget > 0; ++ring) {
+    if (ring > hi_x && ring > hi_y && ring > -lo_x && ring > -lo_y) break;
+    for (int dy = -ring; dy <= ring && budget > 0; ++dy) {
+      if (dy < lo_y || dy > hi_y) continue;
+      // Interior rows only contribute the ring's two edge columns.
+      int step = (dy == -ring || dy == ring) ? 1 : 2 * ring;
+      for (int dx = -ring; dx <= ring && budget > 0; dx += step > 0 ? step : 1) {
+        if (dx < lo_x || dx > hi_x) continue;
+        int cx = (ox + dx + cols) % cols, cy = (oy + dy + rows) % rows;
+        int c = cy * cols + cx;
+        knn_scan_cell(f, &heap, i, px, py, f->cell_start[c], f->cell_start[c + 1], &budget);
+      }
+    }
+    float reach = (float)ring * cell;
+    if (heap.size == k && heap.dist2[0] <= reach * reach) break;
+  }
+
+  for (int n = 0; n < heap.size; ++n) {
+    int j = heap.index[n];
+    float dx = boids_wrap_distance(src->x[j] - px, f->width);
+    float dy = boids_wrap_distance(src->y[j] - py, f->height);
+    float dist2 = heap.dist2[n];
+    st->align_x += src->vx[j];
+    st->align_y += src->vy[j];
+    st->cohesion_x += px + dx;
+    st->cohesion_y += py + dy;
+    if (dist2 < SEPARATION_RADIUS * SEPARATION_RADIUS && dist2 > 0.0001f) {
+      st->separation_x -= dx / dist2;
+      st->separation_y -= dy / dist2;
+    }
+  }
+  st->neighbors += heap.size;
+}
+
+// One steering step for boids [begin, end). Reads only the sorted
+// snapshot in prev and writes into cur, so ranges can run on any thread
+// in any order.
+static void steer_range(void *ctx, int begin, int end) {
+  const StepParams *step = ctx;
+  const BoidsFlock *f = step->flock;
+  const BoidArrays *src = &f->prev;
+  for (int i = begin; i < end; ++i) {
+    float px = src->x[i];
+    float py = src->y[i];
+    float px_screen = boids_wrap_mod(px, f->width);
+    float py_screen = boids_wrap_mod(py, f->height);
+    float vx = src->vx[i];
+    float vy = src->vy[i];
+
+    Steering st = {0};
+
+    int span_x[3], span_y[3];
+    int nx = grid_span(cell_coord(px, f->cell_w, f->grid_cols), f->grid_cols, span_x);
+    int ny = grid_span(cell_coord(py, f->cell_h, f->grid_rows), f->grid_rows, span_y);
+    int far = f->mode == BOIDS_MODE_FARFIELD && f->far_levels > 0;
+    if (f->mode == BOIDS_MODE_KNN) {
+      accumulate_knn(f, &st, i, px, py);
+    } else {
+      for (int cy = 0; cy < ny; ++cy) {
+        for (int cx = 0; cx < nx; ++cx) {
+          int cell = span_y[cy] * f->grid_cols + span_x[cx];
+          int cell_begin = f->cell_start[cell], cell_end = f->cell_start[cell + 1];
+          if (far && cell_end - cell_begin > FAR_DENSE_CELL) {
+            accumulate_sampled(f, &st, i, px, py, cell_begin, cell_end);
+          } else {
+            accumulate_range(f, &st, i, px, py, cell_begin, cell_end);
+          }
+        }
+      }
+      if (far) accumulate_far(f, &st, i, px, py, span_x, nx, span_y, ny);
+    }
+
+    float align_x = st.align_x, align_y = st.align_y;
+    float cohesion_x = st.cohesion_x, cohesion_y = st.cohesion_y;
+    float separation_x = st.separation_x, separation_y = st.separation_y;
+    int neighbors = st.neighbors;
+
+    float accel_x = 0.f;
+    float accel_y = 0.f;
+
+    if (neighbors > 0) {
+      float inv = 1.0f / neighbors;
+      align_x = (align_x * inv - vx) * 1.2f;
+      align_y = (align_y * inv - vy) * 1.2f;
+
+      cohesion_x = ((cohesion_x * inv) - px) * 0.008f;
+      cohesion_y = ((cohesion_y * inv) - py) * 0.008f;
+
+      separation_x *= 10.0f;
+      separation_y *= 10.0f;
+
+      accel_x += align_x + cohesion_x + separation_x;
+      accel_y += align_y + cohesion_y + separation_y;
+    }
+
+    if (step->mouse_present) {
+      float dxm = step->mouse_x - px_screen;
+      float dym = step->mouse_y - py_screen;
+      float distm2 = dxm * dxm + dym * dym;
+      if (distm2 > 25.0f) {
+        float inv = 1.0f / sqrtf(distm2);
+        accel_x += dxm * inv * 160.0f;
+        accel_y += dym * inv * 160.0f;
+      }
+    }
+
+    if (f->width > 0) {
+      float left_dist = px_screen;
+      if (left_dist < EDGE_THRESHOLD) {
+        float t = (EDGE_THRESHOLD - left_dist) * (1.0f / EDGE_THRESHOLD);
+        accel_x += EDGE_FORCE * t;
+      }
+      float right_dist = f->width - px_screen;
+      if (right_dist < EDGE_THRESHOLD) {
+        float t = (EDGE_THRESHOLD - right_dist) * (1.0f / EDGE_THRESHOLD);
+        accel_x -= EDGE_FORCE * t;
+      }
+    }
+    if (f->height > 0) {
+      float top_dist = py_screen;
+      if (top_dist < EDGE_THRESHOLD) {
+        float t = (EDGE_THRESHOLD - top_dist) * (1.0f / EDGE_THRESHOLD);
+        accel_y += EDGE_FORCE * t;
+      }
+      float bottom_dist = f->height - py_screen;
+      if (bottom_dist < EDGE_THRESHOLD) {
+        float t = (EDGE_THRESHOLD - bottom_dist) * (1.0f / EDGE_THRESHOLD);
+        accel_y -= EDGE_FORCE * t;
+      }
+    }
+
+    float speed = sqrtf(vx * vx + vy * vy);
+    if (speed > 0.0001f) {
+      accel_x += (vx / speed) * 6.0f;
+      accel_y += (vy / speed) * 6.0f;
+    }
+
+    float acc_mag = sqrtf(accel_x * accel_x + accel_y * accel_y);
+    if (acc_mag > MAX_FORCE) {
+      float scale = MAX_FORCE / acc_mag;
+      accel_x *= scale;
+      accel_y *= scale;
+    }
+
+    vx += accel_x * step->dt;
+    vy += accel_y * step->dt;
+    float new_speed = sqrtf(vx * vx + vy * vy);
+    if (new_speed > MAX_SPEED) {
+      float scale = MAX_SPEED / new_speed;
+      vx *= scale;
+      vy *= scale;
+    }
+
+    float damp = step->mouse_present ? VELOCITY_DAMP_ACTIVE : VELOCITY_DAMP_IDLE;
+    vx *= damp;
+    vy *= damp;
+
+    if (!step->mouse_present) {
+      float cruise = 80.0f;
+      float speed_after = sqrtf(vx * vx + vy * vy);
+      if (speed_after < cruise) {
+        if (speed_after > 0.0001f) {
+          float scale = cruise / speed_after;
+          vx *= scale;
+          vy *= scale;
+        } else {
+          // Re-inject a tiny random push to keep idle motion alive.
+          float angle = hash_unit(step->seed ^ ((uint32_t)i * 0x9E3779B9u)) * 6.2831853f;
+          vx = cosf(angle) * cruise;
+          vy = sinf(angle) * cruise;
+        }
+      }
+    }
+
+    px += vx * step->dt;
+    py += vy * step->dt;
+
+    f->cur.x[i] = px;
+    f->cur.y[i] = py;
+    f->cur.vx[i] = vx;
+    f->cur.vy[i] = vy;
+  }
+}
+
+// Inputs are sampled once per step and all randomness comes from the
+// flock's RNG, so a seed plus an input sequence replays exactly whatever
+// the thread count.
+void boids_flock_step(BoidsFlock *flock, const BoidsInput *input, float dt) {
+  // Out of memory for the grid: the flock holds still this step.
+  if (!sort_by_cell(flock)) return;
+  if (flock->mode == BOIDS_MODE_FARFIELD) build_pyramid(flock);
+  StepParams step = {
+      .flock = flock,
+      .dt = dt,
+      .mouse_x = input ? input->mouse_x : 0.0f,
+      .mouse_y = input ? input->mouse_y : 0.0f,
+      .mouse_present = input ? input->mouse_present : 0,
+      .seed = boids_rng_next(&flock->rng),
+  };
+  workpool_run(steer_range, &step, flock->count, STEP_CHUNK);
+}
+
+uint32_t boids_flock_checksum(const BoidsFlock *flock) {
+  uint32_t hash = 2166136261u;
+  const float *arrays[] = {flock->cur.x, flock->cur.y, flock->cur.vx, flock->cur.vy};
+  for (size_t a = 0; a < sizeof arrays / sizeof arrays[0]; ++a) {
+    for (int i = 0; i < flock->count; ++i) {
+      uint32_t bits;
+      memcpy(&bits, &arrays[a][i], sizeof bits);
+      for (int b = 0; b < 4; ++b) {
+        hash ^= (bits >> (b * 8)) & 0xFFu;
+        hash *= 16777619u;
+      }
+    }
+  }
+  return hash;
+}
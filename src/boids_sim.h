@@ -0,0 +1,133 @@
+#ifndef BOIDS_SIM_H
+#define BOIDS_SIM_H
+
+#include <math.h>
+#include <stdint.h>
+
+// GL-free flock simulation. It builds into the wasm demo and natively
+// (see `make bench-boids`), so it can be profiled outside a browser.
+
+typedef struct {
+  uint32_t state;
+} BoidsRng;
+
+typedef struct {
+  float *x;
+  float *y;
+  float *vx;
+  float *vy;
+} BoidArrays;
+
+typedef struct {
+  float mouse_x, mouse_y;
+  int mouse_present;
+} BoidsInput;
+
+// How a boid gathers its neighborhood.
+enum {
+  // Every boid within the radius, found through a uniform grid.
+  BOIDS_MODE_GRID = 0,
+  // Exact terms from the surrounding 3x3 fine cells; cohesion and
+  // alignment from farther away come from a grid pyramid, Barnes-Hut style.
+  BOIDS_MODE_FARFIELD = 1,
+  // Topological: only the k nearest boids within the radius, so per-boid
+  // work no longer grows with local density.
+  BOIDS_MODE_KNN = 2,
+  BOIDS_MODE_COUNT
+};
+
+#define BOIDS_MAX_LEVELS 16
+#define BOIDS_MAX_K 32
+
+// Per-cell aggregate of a pyramid level: boid count plus position and
+// velocity sums (centroid and mean velocity are sum / count).
+typedef struct {
+  float count;
+  float sum_x, sum_y;
+  float sum_vx, sum_vy;
+} BoidsCellSum;
+
+typedef struct {
+  float width, height;
+  int count;
+  int capacity;
+  // cur is the latest state. prev is the previous tick, sorted by cell and
+  // index-aligned with cur; each step sorts cur into prev, then writes the
+  // new state back into cur.
+  BoidArrays cur;
+  BoidArrays prev;
+  int *cell_of;
+
+  int mode;
+  float neighbor_radius;
+  // Far-field opening angle: a pyramid cell of size s whose centroid is d
+  // away is taken as a whole when s / d < opening_angle.
+  float opening_angle;
+  // Neighbors per boid in kNN mode, 1..BOIDS_MAX_K.
+  int knn_k;
+
+  // Toroidal uniform grid, rebuilt every step. In grid mode cells are at
+  // least neighbor_radius wide so a 3x3 block covers the neighborhood; in
+  // far-field mode they only need to cover the separation radius.
+  int grid_cols, grid_rows;
+  float cell_w, cell_h;
+  int cell_capacity;
+  int *cell_start;
+  int *cell_cursor;
+
+  // Far-field pyramid. Level 0 matches the grid; each level above halves
+  // it (rounding up) until a single cell remains.
+  int far_levels;
+  int far_cols[BOIDS_MAX_LEVELS];
+  int far_rows[BOIDS_MAX_LEVELS];
+  int far_base[BOIDS_MAX_LEVELS];
+  int far_capacity;
+  BoidsCellSum *far_cells;
+
+  BoidsRng rng;
+  int use_simd;
+} BoidsFlock;
+
+void boids_rng_seed(BoidsRng *rng, uint32_t seed);
+uint32_t boids_rng_next(BoidsRng *rng);
+float boids_rng_unit(BoidsRng *rng);
+
+// 1 when the SIMD steering kernel was compiled in.
+int boids_simd_available(void);
+
+void boids_flock_init(BoidsFlock *flock, float width, float height, uint32_t seed);
+void boids_flock_free(BoidsFlock *flock);
+int boids_flock_reserve(BoidsFlock *flock, int capacity);
+// Scatters `count` fresh boids over the world; returns the count reached.
+int boids_flock_reset(BoidsFlock *flock, int count);
+// Grows the flock by scattering new boids at the tail, or shrinks it by
+// retiring an even stride across the world; survivors keep flying.
+// Returns the count.
+int boids_flock_set_count(BoidsFlock *flock, int count);
+void boids_flock_resize(BoidsFlock *flock, float width, float height);
+// Parameter setters clamp to sane ranges and return the value applied.
+int boids_flock_set_mode(BoidsFlock *flock, int mode);
+float boids_flock_set_radius(BoidsFlock *flock, float radius);
+float boids_flock_set_opening_angle(BoidsFlock *flock, float theta);
+int boids_flock_set_k(BoidsFlock *flock, int k);
+// Advances one tick. Ranges of boids run on the shared worker pool.
+void boids_flock_step(BoidsFlock *flock, const BoidsInput *input, float dt);
+// FNV-1a over the bit patterns of the current state.
+uint32_t boids_flock_checksum(const BoidsFlock *flock);
+
+static inline float boids_wrap_distance(float delta, float extent) {
+  if (extent <= 0.0f) return delta;
+  float half = extent * 0.5f;
+  while (delta > half) delta -= extent;
+  while (delta < -half) delta += extent;
+  return delta;
+}
+
+static inline float boids_wrap_mod(float value, float extent) {
+  if (extent <= 0.0f) return value;
+  float wrapped = fmodf(value, extent);
+  if (wrapped < 0.0f) wrapped += extent;
+  return wrapped;
+}
+
+#endif /* BOIDS_SIM_H */
@@ -0,0 +1,212 @@
+#include <GLES3/gl3.h>
+#include <stddef.h>
+#include <string.h>
+#ifdef DEBUG
+#include <stdio.h>
+#endif
+
+#include "checkerboard.h"
+
+// Full-screen triangle from gl_VertexID, drawn with an empty VAO.
+static const char *RESOLVE_VERT_SRC =
+    "#version 300 es\n"
+    "out vec2 v_pos;\n"
+    "void main(){\n"
+    "  v_pos = vec2(gl_VertexID == 1 ? 3.0 : -1.0, gl_VertexID == 2 ? 3.0 : -1.0);\n"
+    "  gl_Position = vec4(v_pos, 0.0, 1.0);\n"
+    "}\n";
+
+// Pixels of this frame's color are copied from the half-width target.
+// The others take the reprojected history, clamped to the range of their
+// four neighbors (all shaded this frame), or the neighbors' average when
+// there is no usable history.
+static const char *RESOLVE_FRAG_SRC =
+    "#version 300 es\n"
+    "precision highp float;\n"
+    "precision highp int;\n"
+    "in vec2 v_pos;\n"
+    "uniform sampler2D u_current;\n"
+    "uniform sampler2D u_history;\n"
+    "uniform int u_parity;\n"
+    "uniform int u_history_valid;\n"
+    "uniform vec4 u_reproject;\n"
+    "out vec4 fragColor;\n"
+    "vec4 shaded(ivec2 p){\n"
+    "  return texelFetch(u_current, ivec2(p.x >> 1, p.y), 0);\n"
+    "}\n"
+    "void main(){\n"
+    "  ivec2 p = ivec2(gl_FragCoord.xy);\n"
+    "  ivec2 last = textureSize(u_history, 0) - 1;\n"
+    "  if ((p.x & 1) == ((p.y + u_parity) & 1)){\n"
+    "    fragColor = shaded(p);\n"
+    "    return;\n"
+    "  }\n"
+    "  vec4 l = shaded(ivec2(p.x > 0 ? p.x - 1 : min(p.x + 1, last.x), p.y));\n"
+    "  vec4 r = shaded(ivec2(p.x < last.x ? p.x + 1 : max(p.x - 1, 0), p.y));\n"
+    "  vec4 d = shaded(ivec2(p.x, p.y > 0 ? p.y - 1 : min(p.y + 1, last.y)));\n"
+    "  vec4 u = shaded(ivec2(p.x, p.y < last.y ? p.y + 1 : max(p.y - 1, 0)));\n"
+    "  vec2 prev = (v_pos * u_reproject.xy + u_reproject.zw) * 0.5 + 0.5;\n"
+    "  if (u_history_valid == 0 || any(lessThan(prev, vec2(0.0))) || any(greaterThan(prev, vec2(1.0)))){\n"
+    "    fragColor = (l + r + d + u) * 0.25;\n"
+    "    return;\n"
+    "  }\n"
+    "  vec4 h = texture(u_history, prev);\n"
+    "  fragColor = clamp(h, min(min(l, r), min(d, u)), max(max(l, r), max(d, u)));\n"
+    "}\n";
+
+static GLuint compile_shader(GLenum type, const char *src) {
+  GLuint shader = glCreateShader(type);
+  glShaderSource(shader, 1, &src, NULL);
+  glCompileShader(shader);
+  GLint ok = 0;
+  glGetShaderiv(shader, GL_COMPILE_STATUS, &ok);
+  if (!ok) {
+#ifdef DEBUG
+    char log[512];
+    glGetShaderInfoLog(shader, sizeof log, NULL, log);
+    printf("shader compile error: %s\n", log);
+#endif
+    glDeleteShader(shader);
+    return 0;
+  }
+  return shader;
+}
+
+static GLuint link_program(GLuint vs, GLuint fs) {
+  GLuint prog = glCreateProgram();
+  glAttachShader(prog, vs);
+  glAttachShader(prog, fs);
+  glLinkProgram(prog);
+  GLint ok = 0;
+  glGetProgramiv(prog, GL_LINK_STATUS, &ok);
+  if (!ok) {
+#ifdef DEBUG
+    char log[512];
+    glGetProgramInfoLog(prog, sizeof log, NULL, log);
+    printf("program link error: %s\n", log);
+#endif
+    glDeleteProgram(prog);
+    prog = 0;
+  }
+  glDetachShader(prog, vs);
+  glDetachShader(prog, fs);
+  glDeleteShader(vs);
+  glDeleteShader(fs);
+  return prog;
+}
+
+int checkerboard_init(Checkerboard *cb) {
+  memset(cb, 0, sizeof *cb);
+  GLuint vs = compile_shader(GL_VERTEX_SHADER, RESOLVE_VERT_SRC);
+  GLuint fs = compile_shader(GL_FRAGMENT_SHADER, RESOLVE_FRAG_SRC);
+  cb->program = link_program(vs, fs);
+  if (!cb->program) return 0;
+  cb->current_loc = glGetUniformLocation(cb->program, "u_current");
+  cb->history_loc = glGetUniformLocation(cb->program, "u_history");
+  cb->parity_loc = glGetUniformLocation(cb->program, "u_parity");
+  cb->valid_loc = glGetUniformLocation(cb->program, "u_history_valid");
+  cb->reproject_loc = glGetUniformLocation(cb->program, "u_reproject");
+  glGenVertexArrays(1, &cb->vao);
+  return 1;
+}
+
+static void delete_targets(Checkerboard *cb) {
+  if (cb->half_fbo) glDeleteFramebuffers(1, &cb->half_fbo);
+  if (cb->half_tex) glDeleteTextures(1, &cb->half_tex);
+  for (int i = 0; i < 2; ++i) {
+    if (cb->history_fbo[i]) glDeleteFramebuffers(1, &cb->history_fbo[i]);
+    if (cb->history_tex[i]) glDeleteTextures(1, &cb->history_tex[i]);
+    cb->history_fbo[i] = cb->history_tex[i] = 0;
+  }
+  cb->half_fbo = cb->half_tex = 0;
+  cb->width = cb->height = cb->half_width = 0;
+  cb->history_valid = 0;
+}
+
+// RGBA8 texture and framebuffer; history is sampled between pixels when
+// the view moves, so it filters linearly.
+static int make_target(GLuint *tex, GLuint *fbo, int width, int height, GLenum filter) {
+  glGenTextures(1, tex);
+  glBindTexture(GL_TEXTURE_2D, *tex);
+  glTexStorage2D(GL_TEXTURE_2D, 1, GL_RGBA8, width, height);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, filter);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, filter);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+  glGenFramebuffers(1, fbo);
+  glBindFramebuffer(GL_FRAMEBUFFER, *fbo);
+  glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, *tex, 0);
+  GLenum status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+  glBindFramebuffer(GL_FRAMEBUFFER, 0);
+  return status == GL_FRAMEBUFFER_COMPLETE;
+}
+
+int checkerboard_resize(Checkerboard *cb, int width, int height) {
+  if (!cb->program) return 0;
+  if (width < 1) width = 1;
+  if (height < 1) height = 1;
+  if (width == cb->width && height == cb->height) return 1;
+  delete_targets(cb);
+  int half_width = (width + 1) / 2;
+  if (!make_target(&cb->half_tex, &cb->half_fbo, half_width, height, GL_NEAREST) ||
+      !make_target(&cb->history_tex[0], &cb->history_fbo[0], width, height, GL_LINEAR) ||
+      !make_target(&cb->history_tex[1], &cb->history_fbo[1], width, height, GL_LINEAR)) {
+    delete_targets(cb);
+    return 0;
+  }
+  cb->width = width;
+  cb->height = height;
+  cb->half_width = half_width;
+  return 1;
+}
+
+void checkerboard_invalidate(Checkerboard *cb) {
+  cb->history_valid = 0;
+}
+
+void checkerboard_begin(Checkerboard *cb) {
+  glBindFramebuffer(GL_FRAMEBUFFER, cb->half_fbo);
+  glViewport(0, 0, cb->half_width, cb->height);
+}
+
+void checkerboard_set_uniforms(const Checkerboard *cb, GLint parity_loc, GLint width_loc) {
+  if (parity_loc >= 0) glUniform1i(parity_loc, cb->frame & 1);
+  if (width_loc >= 0) glUniform1f(width_loc, (float)cb->width);
+}
+
+void checkerboard_resolve(Checkerboard *cb, const float reproject[4]) {
+  static const float identity[4] = {1.0f, 1.0f, 0.0f, 0.0f};
+  if (!reproject) reproject = identity;
+  int next = cb->current ^ 1;
+  glBindFramebuffer(GL_FRAMEBUFFER, cb->history_fbo[next]);
+  glViewport(0, 0, cb->width, cb->height);
+  glUseProgram(cb->program);
+  glActiveTexture(GL_TEXTURE0);
+  glBindTexture(GL_TEXTURE_2D, cb->half_tex);
+  glActiveTexture(GL_TEXTURE1);
+  glBindTexture(GL_TEXTURE_2D, cb->history_tex[cb->current]);
+  if (cb->current_loc >= 0) glUniform1i(cb->current_loc, 0);
+  if (cb->history_loc >= 0) glUniform1i(cb->history_loc, 1);
+  if (cb->parity_loc >= 0) glUniform1i(cb->parity_loc, cb->frame & 1);
+  if (cb->valid_loc >= 0) glUniform1i(cb->valid_loc, cb->history_valid);
+  if (cb->reproject_loc >= 0) glUniform4fv(cb->reproject_loc, 1, reproject);
+  glBindVertexArray(cb->vao);
+  glDrawArrays(GL_TRIANGLES, 0, 3);
+
+  glBindFramebuffer(GL_READ_FRAMEBUFFER, cb->history_fbo[next]);
+  glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
+  glBlitFramebuffer(0, 0, cb->width, cb->height, 0, 0, cb->width, cb->height, GL_COLOR_BUFFER_BIT, GL_NEAREST);
+  glBindFramebuffer(GL_FRAMEBUFFER, 0);
+  glActiveTexture(GL_TEXTURE0);
+
+  cb->current = next;
+  cb->history_valid = 1;
+  cb->frame++;
+}
+
+void checkerboard_shutdown(Checkerboard *cb) {
+  delete_targets(cb);
+  if (cb->vao) glDeleteVertexArrays(1, &cb->vao);
+  if (cb->program) glDeleteProgram(cb->program);
+  memset(cb, 0, sizeof *cb);
+}
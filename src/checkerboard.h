@@ -0,0 +1,62 @@
+#ifndef CHECKERBOARD_H
+#define CHECKERBOARD_H
+
+#include <GLES3/gl3.h>
+
+// Checkerboard rendering for full-screen passes. Each frame the demo shades
+// half the pixels, alternating between the two checkerboard colors, into a
+// half-width target; a resolve pass rebuilds the full frame from those and
+// last frame's output, reprojected, and copies it to the canvas. History is
+// clamped to the range of the freshly shaded neighbors, so it cannot drift
+// far from the current frame, and it is ignored where reprojection falls
+// outside the last frame or after checkerboard_invalidate().
+//
+// The resolve copies with glBlitFramebuffer, so the demo must be built
+// without MSAA (see RUNTIME_NO_MSAA in runtime_webgl.c).
+
+// Fragment-shader source for the shaded pass. checkerboard_pos(pos) turns
+// the interpolated full-screen position (NDC, as the demo's vertex shader
+// passes it) into that of the full-resolution pixel being shaded; with
+// u_cb_parity < 0 it returns pos unchanged, for full-resolution passes.
+#define CHECKERBOARD_GLSL \
+    "uniform int u_cb_parity;\n" \
+    "uniform float u_cb_width;\n" \
+    "vec2 checkerboard_pos(vec2 pos){\n" \
+    "  if (u_cb_parity < 0) return pos;\n" \
+    "  int o = (int(gl_FragCoord.y) + u_cb_parity) & 1;\n" \
+    "  float x = float(2 * int(gl_FragCoord.x) + o) + 0.5;\n" \
+    "  return vec2(2.0 * x / u_cb_width - 1.0, pos.y);\n" \
+    "}\n"
+
+typedef struct {
+  int width, height;
+  int half_width;
+  int frame;
+  int history_valid;
+  int current;
+  GLuint half_tex, half_fbo;
+  GLuint history_tex[2], history_fbo[2];
+  GLuint program;
+  GLuint vao;
+  GLint current_loc, history_loc, parity_loc, valid_loc, reproject_loc;
+} Checkerboard;
+
+// Builds the resolve program. Returns 0 on failure; the demo then shades
+// at full resolution.
+int checkerboard_init(Checkerboard *cb);
+// (Re)allocates the targets for a width x height canvas and drops the
+// history. Returns 0 when they cannot be rendered to.
+int checkerboard_resize(Checkerboard *cb, int width, int height);
+void checkerboard_invalidate(Checkerboard *cb);
+// Binds the half-width target and its viewport for this frame's pass.
+void checkerboard_begin(Checkerboard *cb);
+// Sets u_cb_parity and u_cb_width on the bound program.
+void checkerboard_set_uniforms(const Checkerboard *cb, GLint parity_loc, GLint width_loc);
+// Rebuilds the full frame into the default framebuffer and leaves it
+// bound with a full viewport. `reproject` maps a pixel's NDC position to
+// where the same content was last frame: prev = pos * xy + zw; NULL means
+// the view did not move.
+void checkerboard_resolve(Checkerboard *cb, const float reproject[4]);
+void checkerboard_shutdown(Checkerboard *cb);
+
+#endif /* CHECKERBOARD_H */
@@ -0,0 +1,93 @@
+#ifndef DD_H
+#define DD_H
+
+// Double-double arithmetic: a value is hi + lo with |lo| <= ulp(hi) / 2,
+// roughly 106 bits of mantissa. Plain Dekker/Knuth error-free transforms
+// without fma, so every target (wasm has no fused multiply-add) rounds
+// the same way. Needs strict IEEE evaluation: no -ffast-math.
+
+typedef struct {
+  double hi, lo;
+} dd;
+
+static inline dd dd_make(double hi, double lo) {
+  dd r = {hi, lo};
+  return r;
+}
+
+static inline dd dd_from(double a) {
+  return dd_make(a, 0.0);
+}
+
+static inline double dd_to_double(dd a) {
+  return a.hi + a.lo;
+}
+
+// a + b exactly, assuming |a| >= |b|.
+static inline dd dd_quick_two_sum(double a, double b) {
+  double s = a + b;
+  return dd_make(s, b - (s - a));
+}
+
+static inline dd dd_two_sum(double a, double b) {
+  double s = a + b;
+  double bb = s - a;
+  return dd_make(s, (a - (s - bb)) + (b - bb));
+}
+
+static inline void dd_split(double a, double *hi, double *lo) {
+  double t = 134217729.0 * a; // 2^27 + 1
+  *hi = t - (t - a);
+  *lo = a - *hi;
+}
+
+static inline dd dd_two_prod(double a, double b) {
+  double p = a * b;
+  double ah, al, bh, bl;
+  dd_split(a, &ah, &al);
+  dd_split(b, &bh, &bl);
+  return dd_make(p, ((ah * bh - p) + ah * bl + al * bh) + al * bl);
+}
+
+static inline dd dd_neg(dd a) {
+  return dd_make(-a.hi, -a.lo);
+}
+
+static inline dd dd_add(dd a, dd b) {
+  dd s = dd_two_sum(a.hi, b.hi);
+  dd t = dd_two_sum(a.lo, b.lo);
+  s.lo += t.hi;
+  s = dd_quick_two_sum(s.hi, s.lo);
+  s.lo += t.lo;
+  return dd_quick_two_sum(s.hi, s.lo);
+}
+
+static inline dd dd_sub(dd a, dd b) {
+  return dd_add(a, dd_neg(b));
+}
+
+static inline dd dd_add_d(dd a, double b) {
+  dd s = dd_two_sum(a.hi, b);
+  s.lo += a.lo;
+  return dd_quick_two_sum(s.hi, s.lo);
+}
+
+static inline dd dd_mul(dd a, dd b) {
+  dd p = dd_two_prod(a.hi, b.hi);
+  p.lo += a.hi * b.lo + a.lo * b.hi;
+  return dd_quick_two_sum(p.hi, p.lo);
+}
+
+static inline dd dd_mul_d(dd a, double b) {
+  dd p = dd_two_prod(a.hi, b);
+  p.lo += a.lo * b;
+  return dd_quick_two_sum(p.hi, p.lo);
+}
+
+static inline dd dd_sqr(dd a) {
+  dd p = dd_two_prod(a.hi, a.hi);
+  p.lo += 2.0 * a.hi * a.lo;
+  return dd_quick_two_sum(p.hi, p.lo);
+}
+
+#endif /* DD_H */
@@ -1,12 +1,72 @@
 #ifndef DEMO_APP_H
 #define DEMO_APP_H
 
+// The combined build (see demo_registry.c) links every demo into one
+// module; each is compiled with -DDEMO_APP_PREFIX=<name>, which renames its
+// hooks to <name>_app_*.
+#ifdef DEMO_APP_PREFIX
+#define DEMO_APP_GLUE2(prefix, hook) prefix##_app_##hook
+#define DEMO_APP_GLUE(prefix, hook) DEMO_APP_GLUE2(prefix, hook)
+#define demo_app_init DEMO_APP_GLUE(DEMO_APP_PREFIX, init)
+#define demo_app_resize DEMO_APP_GLUE(DEMO_APP_PREFIX, resize)
+#define demo_app_frame DEMO_APP_GLUE(DEMO_APP_PREFIX, frame)
+#define demo_app_set_active DEMO_APP_GLUE(DEMO_APP_PREFIX, set_active)
+#define demo_app_handle_key DEMO_APP_GLUE(DEMO_APP_PREFIX, handle_key)
+#define demo_app_update_mouse DEMO_APP_GLUE(DEMO_APP_PREFIX, update_mouse)
+#define demo_app_shutdown DEMO_APP_GLUE(DEMO_APP_PREFIX, shutdown)
+#endif
+
+// demo_app_frame result bits. A frame that returns neither is idle: the
+// runtime leaves the canvas as it is and stops ticking until input, a
+// resize or runtime_request_frame(). The frame after demo_app_init or
+// demo_app_resize must draw.
+#define DEMO_FRAME_DRAWN 1 // new content to present
+#define DEMO_FRAME_AGAIN 2 // tick again on the next display frame
+// Progressive work on a still view is in flight; a resize would throw it
+// away, so the runtime holds the render scale until it is done.
+#define DEMO_FRAME_REFINING 4
+
+// Each frame starts with the demo's target bound as framebuffer 0, a full
+// viewport and texture unit 0 active; other GL state is the demo's to set.
+// demo_app_resize gets the render size, which follows the runtime's render
+// scale and the display's pixel ratio; demos that lay things out in CSS
+// pixels divide it by runtime_pixel_ratio().
 void demo_app_init(int width, int height);
 void demo_app_resize(int width, int height);
-void demo_app_frame(double time_sec, double dt_sec);
+int demo_app_frame(double time_sec, double dt_sec);
 void demo_app_set_active(int active);
 void demo_app_handle_key(int key, int pressed);
 void demo_app_update_mouse(float x, float y, int present);
 void demo_app_shutdown(void);
 
+// Provided by the runtime: wakes it for a frame after delay_ms (0 for the
+// next display frame), e.g. when an exported setter changed the demo.
+void runtime_request_frame(double delay_ms);
+// Render-target pixels per CSS pixel of the demo's canvas (devicePixelRatio
+// times the render scale), for the demo whose hook is running.
+double runtime_pixel_ratio(void);
+
+// Dispatch table entry: a demo's hooks plus the runtime settings it is
+// built with (render scale bounds, MSAA, GPU frame timing). Demos that run
+// their own EXT_disjoint_timer_query queries turn gpu_timer off, since
+// TIME_ELAPSED queries cannot nest.
+typedef struct {
+  const char *name;
+  void (*init)(int width, int height);
+  void (*resize)(int width, int height);
+  int (*frame)(double time_sec, double dt_sec);
+  void (*set_active)(int active);
+  void (*handle_key)(int key, int pressed);
+  void (*update_mouse)(float x, float y, int present);
+  void (*shutdown)(void);
+  double min_scale, max_scale;
+  int msaa;
+  int gpu_timer;
+} DemoApp;
+
+// Demos linked into this module: the runtime's own single entry, or every
+// demo in the combined build.
+extern const DemoApp demo_apps[];
+extern const int demo_app_count;
+
 #endif /* DEMO_APP_H */
@@ -0,0 +1,29 @@
+#include "demo_app.h"
+
+// Dispatch table of the combined build. The scale bounds, MSAA and GPU
+// timer settings match the per-demo flags in the Makefile (<name>_FLAGS).
+#define DEMO_APP_DECLARE(name) \
+  void name##_app_init(int width, int height); \
+  void name##_app_resize(int width, int height); \
+  int name##_app_frame(double time_sec, double dt_sec); \
+  void name##_app_set_active(int active); \
+  void name##_app_handle_key(int key, int pressed); \
+  void name##_app_update_mouse(float x, float y, int present); \
+  void name##_app_shutdown(void);
+
+#define DEMO_APP_ENTRY(name, min_scale, max_scale, msaa, gpu_timer) \
+  {#name, name##_app_init, name##_app_resize, name##_app_frame, name##_app_set_active, \
+   name##_app_handle_key, name##_app_update_mouse, name##_app_shutdown, min_scale, max_scale, msaa, gpu_timer}
+
+DEMO_APP_DECLARE(tri)
+DEMO_APP_DECLARE(plasma)
+DEMO_APP_DECLARE(mandelbrot)
+DEMO_APP_DECLARE(boids)
+
+const DemoApp demo_apps[] = {
+    DEMO_APP_ENTRY(tri, 1.0, 1.0, 1, 1),
+    DEMO_APP_ENTRY(plasma, 0.35, 1.0, 0, 1),
+    DEMO_APP_ENTRY(mandelbrot, 0.5, 1.0, 0, 0),
+    DEMO_APP_ENTRY(boids, 1.0, 1.0, 1, 1),
+};
+const int demo_app_count = sizeof demo_apps / sizeof demo_apps[0];
@@ -1,29 +1,241 @@
 #include <GLES3/gl3.h>
+#include <emscripten.h>
+#include <emscripten/html5.h>
 #include <math.h>
 #include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
 #include <string.h>
 #ifdef DEBUG
 #include <stdio.h>
 #endif
 
+#include "checkerboard.h"
+#include "dd.h"
 #include "demo_app.h"
+#include "mandelbrot_cpu.h"
+#include "workpool.h"
+
+// Arithmetic tiers by zoom depth: plain float while a pixel spans at least
+// FF_PIXEL, float-float (hi + lo pairs, ~48 bits) down to DEEP_SCALE, then
+// perturbation against a double-double reference orbit. FLOAT_MIN_SCALE
+// is the zoom floor when only the float tier is available.
+#define FLOAT_MIN_SCALE 0.0002
+#define FF_PIXEL 3e-6
+#define DEEP_SCALE 1e-11
+#define DEEP_MIN_SCALE 1e-28
+#define MAX_SCALE 4.0
+#define DEEP_MAX_ITER 2000
+// Reference orbits are computed this many iterations per frame, so a new
+// reference never stalls the main loop.
+#define ORBIT_STEPS_PER_FRAME 4096
+#define ORBIT_TEX_WIDTH 1024
+// A reference is replaced once the view center drifts this far from it,
+// in units of g_scale.
+#define REF_DRIFT 1.0
+// Float-tier views are composed from cached TILE_SIZE^2 tiles of smooth
+// counts and distance estimates. A level-L tile spans TILE_WORLD / 2^L of the plane, anchored at
+// the origin, so tiles line up across levels as a quadtree.
+#define TILE_SIZE 256
+#define TILE_WORLD 4.0
+#define TILE_HASH_SIZE 1024
+#define DEFAULT_TILE_BUDGET_MB 48
+// How far up the pyramid a missing tile looks for a stand-in.
+#define TILE_PARENT_LEVELS 8
+// Visible tiles per axis the index texture can hold.
+#define TILE_INDEX_MAX 64
+// Iteration limits grow by ITER_PER_OCTAVE for every halving of g_scale
+// below ITER_BASE_SCALE, up to DEEP_MAX_ITER.
+#define ITER_BASE 150
+#define ITER_BASE_SCALE 2.0
+#define ITER_PER_OCTAVE 40.0
+// While the view moves, untiled views are drawn at 1/COARSE_DIV resolution
+// with a quarter of the iteration limit; once it settles they are refined
+// to full resolution in scissored bands.
+#define COARSE_DIV 4
+// Refinement work per frame is steered toward this much GPU time.
+#define REFINE_BUDGET_MS 6.0
+#define REFINE_MIN_PIXELS 16384.0
+#define REFINE_MAX_PIXELS 8388608.0
+// Once a view is refined, pixels the distance estimate puts within
+// AA_DE_PIXELS of the set, or whose smooth count differs from a neighbor's
+// by more than AA_CONTRAST, get AA_SAMPLES extra jittered samples (one
+// RGBA texel of the AA target).
+#define AA_DE_PIXELS 1.0
+#define AA_CONTRAST 0.04
+#define AA_SAMPLES 4
+#ifndef GL_TIME_ELAPSED_EXT
+#define GL_TIME_ELAPSED_EXT 0x88BF
+#endif
+#ifndef GL_GPU_DISJOINT_EXT
+#define GL_GPU_DISJOINT_EXT 0x8FBB
+#endif
+#define STR(x) #x
+#define XSTR(x) STR(x)
 
-static GLuint g_program = 0;
 static GLuint g_vao = 0;
 static GLuint g_vbo = 0;
-static GLint g_time_loc = -1;
-static GLint g_aspect_loc = -1;
-static GLint g_center_loc = -1;
-static GLint g_scale_loc = -1;
 static int g_width = 0;
 static int g_height = 0;
 
-static float g_center_x = -0.5f;
-static float g_center_y = 0.0f;
-static float g_scale = 1.8f;
+enum { TIER_FLOAT, TIER_FF, TIER_DEEP, TIER_COUNT };
+enum { PASS_PLAIN, PASS_AA, PASS_COUNT };
+
+// Iteration program of one tier and pass. Locations a tier does not use
+// stay -1: float-float takes center and scale as hi/lo float pairs (plus
+// u_one), deep takes the reference orbit and the center's offset from it,
+// and AA passes read back the iteration target.
+typedef struct {
+  GLuint program;
+  GLint time_loc, aspect_loc, max_iter_loc, period_eps_loc, pixel_loc;
+  GLint center_loc, center_lo_loc, scale_loc, one_loc;
+  GLint orbit_loc, ref_len_loc, offset_loc;
+  GLint iter_loc, texel_loc;
+  GLint cb_parity_loc, cb_width_loc;
+} IterProgram;
+
+static IterProgram g_iter_programs[TIER_COUNT][PASS_COUNT];
+// Cleared when check_ff_precision finds that the GPU compiler folded the
+// float-float error terms; perturbation then takes over from the float tier.
+static int g_ff_exact = 1;
+
+// Reference orbit texture for the deep tier (RG32F, one Z_n per texel,
+// row-major in ORBIT_TEX_WIDTH wide rows).
+static GLuint g_orbit_tex = 0;
+static int g_orbit_tex_rows = 0;
+
+// Smooth iteration counts and distance estimates are rendered into an
+// RG32F target and kept until the view changes; every frame only runs the
+// palette pass over it. Without float render targets (g_direct) the
+// iteration shaders color directly.
+static GLuint g_iter_tex = 0;
+static GLuint g_iter_fbo = 0;
+static int g_iter_w = 0;
+static int g_iter_h = 0;
+static int g_iter_valid = 0;
+static int g_direct = 0;
+// Direct frames are shaded every frame, so they go through the checkerboard
+// helper: half the pixels per frame, the rest reprojected from the last
+// frame's view (g_iter_view). g_cb_pass is set while drawing into it.
+static Checkerboard g_cb;
+static int g_cb_ready = 0;
+static int g_cb_pass = 0;
+static int g_checkerboard = 1;
+static GLuint g_palette_program = 0;
+static GLint g_palette_time_loc = -1;
+static GLint g_palette_iter_loc = -1;
+static GLint g_palette_coarse_loc = -1;
+static GLint g_palette_refined_loc = -1;
+static GLint g_palette_aa_loc = -1;
+static GLint g_palette_aa_rows_loc = -1;
+
+// Low-resolution stand-in for the rows of the iteration target that have
+// not been refined yet (g_refined_rows counts up from the bottom).
+static GLuint g_coarse_tex = 0;
+static GLuint g_coarse_fbo = 0;
+static int g_coarse_w = 0;
+static int g_coarse_h = 0;
+static int g_refined_rows = 0;
+
+// Extra samples for edge pixels (RGBA16F, -1 where a pixel needs none),
+// filled in bands like the refinement; g_aa_rows counts up from the bottom
+// and restarts whenever the iteration target changes.
+static GLuint g_aa_tex = 0;
+static GLuint g_aa_fbo = 0;
+static int g_aa_rows = 0;
+static int g_aa = 1;
+
+// Refinement budget in pixels per frame. With EXT_disjoint_timer_query the
+// refinement passes are timed on the GPU (one query in flight); without
+// it the frame interval is the signal.
+static double g_refine_pixels = 4.0 * REFINE_MIN_PIXELS;
+static double g_refine_last = 0.0;
+static GLuint g_timer_query = 0;
+static int g_timer_pending = 0;
+static double g_timer_pixels = 0.0;
+
+// What the cached iteration buffer was rendered for.
+typedef struct {
+  dd cx, cy;
+  double scale;
+  int tier;
+  int ref_serial;
+  int width, height;
+} ViewKey;
+
+static ViewKey g_iter_view;
+
+// CPU renderer (software GL contexts, or on request): smooth counts are
+// computed on the worker pool and uploaded into the same targets, so the
+// palette pass is shared. Float precision only, like the float shader.
+static int g_cpu = 0;
+static float *g_cpu_pixels = NULL;
+static size_t g_cpu_capacity = 0;
+
+// Tile cache: one layer of g_tile_tex per slot, found through a chained
+// hash on (level, tx, ty) and evicted least recently used. A slot used in
+// the current frame is never evicted.
+typedef struct {
+  int level;
+  int64_t tx, ty;
+  unsigned last_used;
+  int used;
+  int next;
+} TileSlot;
+
+static GLuint g_tile_tex = 0;
+static GLuint g_tile_fbo = 0;
+static TileSlot *g_tiles = NULL;
+static int g_tile_slots = 0;
+static int g_tile_hash[TILE_HASH_SIZE];
+static unsigned g_tile_frame = 0;
+static int g_tile_budget_mb = DEFAULT_TILE_BUDGET_MB;
+static int g_tiles_pending = 0;
+// Per visible tile: (layer, offset x, offset y, extent) of the cached tile
+// covering it, itself or an ancestor; layer -1 when there is none.
+static GLuint g_index_tex = 0;
+static float g_index_data[TILE_INDEX_MAX * TILE_INDEX_MAX * 4];
+static GLuint g_compose_program = 0;
+static GLint g_compose_tiles_loc = -1;
+static GLint g_compose_index_loc = -1;
+static GLint g_compose_aspect_loc = -1;
+static GLint g_compose_view_loc = -1;
+static GLint g_compose_span_loc = -1;
+static GLint g_compose_de_scale_loc = -1;
+
+// The view center needs more than double precision once g_scale drops
+// below ~1e-15, so it is kept as double-double.
+static dd g_center_x = {-0.5, 0.0};
+static dd g_center_y = {0.0, 0.0};
+static double g_scale = 1.8;
 static int g_active = 0;
 static int g_key_left = 0, g_key_right = 0, g_key_up = 0, g_key_down = 0;
 static int g_key_zoom_in = 0, g_key_zoom_out = 0;
+// Palette cycling; while it is off the palette stays at g_palette_time and
+// a finished view stops the frame loop.
+static int g_animate = 1;
+static double g_palette_time = 0.0;
+// Frames the view has stayed unchanged, and whether the next frame must
+// draw regardless (resize, activation, setters).
+static int g_still_frames = 0;
+static int g_redraw = 1;
+
+// Reference orbit Z_0..Z_{len-1} of the point (cx, cy), iterated in
+// double-double and stored as floats for upload.
+typedef struct {
+  dd cx, cy;
+  dd zx, zy;
+  int len;
+  int running;
+  float *orbit;
+} RefOrbit;
+
+static RefOrbit g_pending = {0};
+// Reference currently in g_orbit_tex; ref_len == 0 means none yet.
+static dd g_ref_x = {0.0, 0.0};
+static dd g_ref_y = {0.0, 0.0};
+static int g_ref_len = 0;
+static int g_ref_serial = 0;
 
 static const char *VERT_SRC =
     "#version 300 es\n"
@@ -34,41 +246,338 @@ static const char *VERT_SRC =
     "  gl_Position = vec4(a_pos, 0.0, 1.0);\n"
     "}\n";
 
+// Fragment shaders are assembled as GLSL_VERSION, optional defines,
+// FRAG_PRELUDE and a body. shade() maps m, the smooth escape count / 150
+// (0 for points that never escaped), to a color.
+#define GLSL_VERSION "#version 300 es\n"
+#define FRAG_PRELUDE \
+    "precision highp float;\n" \
+    "precision highp int;\n" \
+    "in vec2 v_pos;\n" \
+    "uniform float u_time;\n" \
+    "uniform float u_aspect;\n" \
+    "out vec4 fragColor;\n" \
+    "vec3 palette(float t){\n" \
+    "  return vec3(0.5 + 0.5 * cos(6.2831 * (t + vec3(0.0, 0.33, 0.67))));\n" \
+    "}\n" \
+    "vec4 shade(float m){\n" \
+    "  float hue = fract(m + 0.15 * sin(u_time * 0.3));\n" \
+    "  vec3 col = (m == 0.0) ? vec3(0.05, 0.06, 0.08) : palette(hue);\n" \
+    "  return vec4(col, 1.0);\n" \
+    "}\n"
+
+// Iteration bodies define iterate(pos), which returns (m, distance
+// estimate in pixels) for v_pos = pos; the estimate is 0 for points that
+// never escaped. ITER_PRELUDE has the parts every tier shares.
+//
+// Interior fast paths, the same as in mandelbrot_cpu.c: closed-form main
+// cardioid and period-2 bulb tests before iterating, and Brent's cycle
+// detection (an orbit back within u_period_eps of the saved point) inside
+// the loop. Both leave m = 0, as running out of iterations would.
+//
+// The distance estimate |z| ln|z| / |dz/dc| tracks the derivative next to
+// z; u_pixel is the pixel size in the units dz is kept in.
+#define ITER_PRELUDE \
+    "uniform int u_max_iter;\n" \
+    "uniform float u_period_eps;\n" \
+    "uniform float u_pixel;\n" \
+    "vec2 cmul(vec2 a, vec2 b){\n" \
+    "  return vec2(a.x*b.x - a.y*b.y, a.x*b.y + a.y*b.x);\n" \
+    "}\n" \
+    "bool interior(vec2 c){\n" \
+    "  float x = c.x - 0.25;\n" \
+    "  float y2 = c.y * c.y;\n" \
+    "  float q = x * x + y2;\n" \
+    "  if (q * (q + x) < 0.25 * y2 - " XSTR(MANDELBROT_INTERIOR_MARGIN) ") return true;\n" \
+    "  float b = c.x + 1.0;\n" \
+    "  return b * b + y2 < 0.0625 - " XSTR(MANDELBROT_INTERIOR_MARGIN) ";\n" \
+    "}\n" \
+    "float estimate(vec2 z, vec2 dz){\n" \
+    "  float r = length(z);\n" \
+    "  return r * log(r) / (length(dz) * u_pixel);\n" \
+    "}\n"
+
+// Shared entry point, appended after each body. Plain passes store
+// (m, estimate) per pixel, or a color in DIRECT builds. AA passes read
+// that back and, for pixels the estimate puts within AA_DE_PIXELS of the
+// set or whose m jumps by more than AA_CONTRAST to a neighbor, store four
+// more samples jittered within the quadrants of the pixel; other pixels
+// store -1.
+#define MAIN_SRC \
+    "#ifdef AA\n" \
+    "uniform highp sampler2D u_iter;\n" \
+    "uniform vec2 u_texel;\n" \
+    "vec2 jitter(ivec2 p, int k){\n" \
+    "  uint h = uint(p.x) * 1973u + uint(p.y) * 9277u + uint(k) * 26699u;\n" \
+    "  h = (h ^ (h >> 13)) * 0x5bd1e995u;\n" \
+    "  h ^= h >> 15;\n" \
+    "  return vec2(float(h & 0xffffu), float(h >> 16)) / 65536.0;\n" \
+    "}\n" \
+    "void main(){\n" \
+    "  ivec2 p = ivec2(gl_FragCoord.xy);\n" \
+    "  ivec2 last = textureSize(u_iter, 0) - 1;\n" \
+    "  vec2 c = texelFetch(u_iter, p, 0).rg;\n" \
+    "  float lo = c.r, hi = c.r;\n" \
+    "  for (int k = 0; k < 4; ++k){\n" \
+    "    ivec2 o = ivec2(k == 0 ? 1 : k == 1 ? -1 : 0, k == 2 ? 1 : k == 3 ? -1 : 0);\n" \
+    "    float n = texelFetch(u_iter, clamp(p + o, ivec2(0), last), 0).r;\n" \
+    "    lo = min(lo, n);\n" \
+    "    hi = max(hi, n);\n" \
+    "  }\n" \
+    "  bool edge = (c.r > 0.0 && c.g < " XSTR(AA_DE_PIXELS) ") || (lo == 0.0 && hi > 0.0) ||\n" \
+    "              hi - lo > " XSTR(AA_CONTRAST) ";\n" \
+    "  if (!edge){\n" \
+    "    fragColor = vec4(-1.0);\n" \
+    "    return;\n" \
+    "  }\n" \
+    "  vec4 s;\n" \
+    "  for (int k = 0; k < 4; ++k){\n" \
+    "    vec2 o = (vec2(k & 1, k >> 1) + jitter(p, k)) * 0.5 - 0.5;\n" \
+    "    s[k] = iterate(v_pos + u_texel * o).r;\n" \
+    "  }\n" \
+    "  fragColor = s;\n" \
+    "}\n" \
+    "#elif defined(DIRECT)\n" \
+    CHECKERBOARD_GLSL \
+    "void main(){\n" \
+    "  fragColor = shade(iterate(checkerboard_pos(v_pos)).x);\n" \
+    "}\n" \
+    "#else\n" \
+    "void main(){\n" \
+    "  fragColor = vec4(iterate(v_pos), 0.0, 1.0);\n" \
+    "}\n" \
+    "#endif\n"
+
 static const char *FRAG_SRC =
-    "#version 300 es\n"
-    "precision highp float;\n"
-    "in vec2 v_pos;\n"
-    "uniform float u_time;\n"
-    "uniform float u_aspect;\n"
     "uniform vec2 u_center;\n"
     "uniform float u_scale;\n"
-    "out vec4 fragColor;\n"
-    "vec3 palette(float t){\n"
-    "  return vec3(0.5 + 0.5 * cos(6.2831 * (t + vec3(0.0, 0.33, 0.67))));\n"
-    "}\n"
-    "void main(){\n"
-    "  vec2 uv = v_pos;\n"
+    ITER_PRELUDE
+    "vec2 iterate(vec2 pos){\n"
+    "  vec2 uv = pos;\n"
     "  uv.x *= u_aspect;\n"
     "  vec2 c = u_center + uv * u_scale;\n"
-    "  vec2 z = vec2(0.0);\n"
-    "  float m = 0.0;\n"
-    "  const int ITER = 150;\n"
-    "  for (int i = 0; i < ITER; ++i){\n"
+    "  vec2 z = vec2(0.0), dz = vec2(0.0);\n"
+    "  vec2 saved = z;\n"
+    "  int lam = 0, power = 1;\n"
+    "  int n = interior(c) ? 0 : u_max_iter;\n"
+    "  for (int i = 0; i < n; ++i){\n"
+    "    dz = 2.0 * cmul(z, dz) + vec2(1.0, 0.0);\n"
     "    z = vec2(z.x*z.x - z.y*z.y, 2.0*z.x*z.y) + c;\n"
     "    if (dot(z,z) > 4.0){\n"
     "      float nu = float(i) - log2(log2(dot(z,z))) + 4.0;\n"
-    "      m = clamp(nu / float(ITER), 0.0, 1.0);\n"
-    "      break;\n"
+    "      return vec2(max(nu, 1e-3) / 150.0, estimate(z, dz));\n"
+    "    }\n"
+    "    if (all(lessThan(abs(z - saved), vec2(u_period_eps)))) break;\n"
+    "    if (++lam == power){\n"
+    "      saved = z;\n"
+    "      power *= 2;\n"
+    "      lam = 0;\n"
+    "    }\n"
+    "  }\n"
+    "  return vec2(0.0);\n"
+    "}\n"
+    MAIN_SRC;
+
+// Float-float: each value is hi + lo with |lo| <= ulp(hi) / 2, using the
+// same error-free transforms as dd.h with a 2^12 + 1 split. u_one is 1.0
+// at run time. Every x - (y - z) is an error term that reassociation alone
+// would fold to 0, so the inner difference goes through u_one, which the
+// compiler cannot see past. Whether that held is checked once on the GPU
+// (see check_ff_precision). Escape is tested on the hi parts, and the
+// derivative only needs float.
+#define FF_GLSL \
+    "uniform float u_one;\n" \
+    "vec2 quick_two_sum(float a, float b){\n" \
+    "  float s = (a + b) * u_one;\n" \
+    "  float e = (s - a) * u_one;\n" \
+    "  return vec2(s, b - e);\n" \
+    "}\n" \
+    "vec2 two_sum(float a, float b){\n" \
+    "  float s = (a + b) * u_one;\n" \
+    "  float bb = (s - a) * u_one;\n" \
+    "  float aa = (s - bb) * u_one;\n" \
+    "  return vec2(s, (a - aa) + (b - bb));\n" \
+    "}\n" \
+    "vec2 split(float a){\n" \
+    "  float t = (4097.0 * a) * u_one;\n" \
+    "  float d = (t - a) * u_one;\n" \
+    "  float hi = t - d;\n" \
+    "  return vec2(hi, a - hi);\n" \
+    "}\n" \
+    "vec2 two_prod(float a, float b){\n" \
+    "  float p = (a * b) * u_one;\n" \
+    "  vec2 sa = split(a), sb = split(b);\n" \
+    "  return vec2(p, ((sa.x * sb.x - p) + sa.x * sb.y + sa.y * sb.x) + sa.y * sb.y);\n" \
+    "}\n" \
+    "vec2 ff_add(vec2 a, vec2 b){\n" \
+    "  vec2 s = two_sum(a.x, b.x);\n" \
+    "  vec2 t = two_sum(a.y, b.y);\n" \
+    "  s.y += t.x;\n" \
+    "  s = quick_two_sum(s.x, s.y);\n" \
+    "  s.y += t.y;\n" \
+    "  return quick_two_sum(s.x, s.y);\n" \
+    "}\n" \
+    "vec2 ff_mul(vec2 a, vec2 b){\n" \
+    "  vec2 p = two_prod(a.x, b.x);\n" \
+    "  p.y += a.x * b.y + a.y * b.x;\n" \
+    "  return quick_two_sum(p.x, p.y);\n" \
+    "}\n"
+
+static const char *FF_FRAG_SRC =
+    "uniform vec2 u_center;\n"
+    "uniform vec2 u_center_lo;\n"
+    "uniform vec2 u_scale;\n"
+    ITER_PRELUDE
+    FF_GLSL
+    "vec2 iterate(vec2 pos){\n"
+    "  vec2 uv = pos;\n"
+    "  uv.x *= u_aspect;\n"
+    "  vec2 cx = ff_add(vec2(u_center.x, u_center_lo.x), ff_mul(vec2(uv.x, 0.0), u_scale));\n"
+    "  vec2 cy = ff_add(vec2(u_center.y, u_center_lo.y), ff_mul(vec2(uv.y, 0.0), u_scale));\n"
+    "  vec2 zx = vec2(0.0), zy = vec2(0.0), dz = vec2(0.0);\n"
+    "  vec2 sx = zx, sy = zy;\n"
+    "  int lam = 0, power = 1;\n"
+    "  int n = interior(vec2(cx.x, cy.x)) ? 0 : u_max_iter;\n"
+    "  for (int i = 0; i < n; ++i){\n"
+    "    dz = 2.0 * cmul(vec2(zx.x, zy.x), dz) + vec2(1.0, 0.0);\n"
+    "    vec2 x2 = ff_mul(zx, zx);\n"
+    "    vec2 y2 = ff_mul(zy, zy);\n"
+    "    vec2 xy = ff_mul(zx, zy);\n"
+    "    zx = ff_add(ff_add(x2, -y2), cx);\n"
+    "    zy = ff_add(2.0 * xy, cy);\n"
+    "    float r2 = zx.x * zx.x + zy.x * zy.x;\n"
+    "    if (r2 > 4.0){\n"
+    "      float nu = float(i) - log2(log2(r2)) + 4.0;\n"
+    "      return vec2(max(nu, 1e-3) / 150.0, estimate(vec2(zx.x, zy.x), dz));\n"
+    "    }\n"
+    "    if (abs(ff_add(zx, -sx).x) < u_period_eps && abs(ff_add(zy, -sy).x) < u_period_eps) break;\n"
+    "    if (++lam == power){\n"
+    "      sx = zx;\n"
+    "      sy = zy;\n"
+    "      power *= 2;\n"
+    "      lam = 0;\n"
+    "    }\n"
+    "  }\n"
+    "  return vec2(0.0);\n"
+    "}\n"
+    MAIN_SRC;
+
+// Precision probe for FF_GLSL, run once per context: maps u_pos onto a
+// 1e-10 view centered at u_center the way the float-float tier maps
+// pixels, where the offset only survives in the lo parts, and squares
+// u_square = 1 + 2^-20, whose lo part 2^-40 needs split(). Green when
+// both come out right.
+static const char *FF_PROBE_SRC =
+    "uniform float u_center;\n"
+    "uniform vec2 u_scale;\n"
+    "uniform float u_pos;\n"
+    "uniform float u_square;\n"
+    FF_GLSL
+    "void main(){\n"
+    "  vec2 c = ff_add(vec2(u_center, 0.0), ff_mul(vec2(u_pos, 0.0), u_scale));\n"
+    "  float pos = ff_add(c, vec2(-u_center, 0.0)).x / u_scale.x;\n"
+    "  vec2 sq = two_prod(u_square, u_square);\n"
+    "  float lo = ff_add(sq, vec2(-(1.0 + exp2(-19.0)), 0.0)).x * exp2(40.0);\n"
+    "  bool ok = abs(pos - u_pos) < 1e-3 * u_pos && abs(lo - 1.0) < 1e-3;\n"
+    "  fragColor = ok ? vec4(0.0, 1.0, 0.0, 1.0) : vec4(1.0, 0.0, 0.0, 1.0);\n"
+    "}\n";
+
+// Perturbation: with Z_n the reference orbit and z_n = Z_n + d_n,
+//   d_{n+1} = 2 Z_n d_n + d_n^2 + dc.
+// Deltas are kept in units of u_scale (= g_scale) so they stay in float
+// range at any depth; so is the derivative, which keeps it near the pixel
+// count instead of overflowing. When |z_n| < |d_n| the delta has lost its
+// precision against the reference (a glitch), and when the reference runs
+// out it cannot continue; both rebase: d = z, restarting at Z_0 = 0.
+static const char *DEEP_FRAG_SRC =
+    "uniform highp sampler2D u_orbit;\n"
+    "uniform int u_ref_len;\n"
+    "uniform vec2 u_ref_offset;\n"
+    "uniform float u_scale;\n"
+    ITER_PRELUDE
+    "vec2 orbit(int n){\n"
+    "  return texelFetch(u_orbit, ivec2(n & 1023, n >> 10), 0).xy;\n"
+    "}\n"
+    "vec2 iterate(vec2 pos){\n"
+    "  vec2 uv = pos;\n"
+    "  uv.x *= u_aspect;\n"
+    "  vec2 dc = uv + u_ref_offset;\n"
+    "  float s = u_scale;\n"
+    "  vec2 d = vec2(0.0), z = vec2(0.0), dz = vec2(0.0);\n"
+    "  int ref = 0;\n"
+    "  for (int i = 0; i < u_max_iter; ++i){\n"
+    "    dz = 2.0 * cmul(z, dz) + vec2(s, 0.0);\n"
+    "    d = 2.0 * cmul(orbit(ref), d) + cmul(d, s * d) + dc;\n"
+    "    ref++;\n"
+    "    z = orbit(ref) + s * d;\n"
+    "    float r2 = dot(z, z);\n"
+    "    if (r2 > 4.0){\n"
+    "      float nu = float(i) - log2(log2(r2)) + 4.0;\n"
+    "      return vec2(max(nu, 1e-3) / 150.0, estimate(z, dz));\n"
+    "    }\n"
+    "    vec2 sd = s * d;\n"
+    "    if (r2 < dot(sd, sd) || ref >= u_ref_len - 1){\n"
+    "      d = z / s;\n"
+    "      ref = 0;\n"
+    "    }\n"
+    "  }\n"
+    "  return vec2(0.0);\n"
+    "}\n"
+    MAIN_SRC;
+
+// One texel fetch and the palette per pixel; rows above u_refined_rows
+// still read the coarse target. Below u_aa_rows, edge pixels average the
+// colors of their center and extra samples.
+static const char *PALETTE_FRAG_SRC =
+    "uniform highp sampler2D u_iter;\n"
+    "uniform highp sampler2D u_coarse;\n"
+    "uniform highp sampler2D u_aa;\n"
+    "uniform int u_refined_rows;\n"
+    "uniform int u_aa_rows;\n"
+    "const int COARSE_DIV = " XSTR(COARSE_DIV) ";\n"
+    "void main(){\n"
+    "  ivec2 p = ivec2(gl_FragCoord.xy);\n"
+    "  float m = p.y < u_refined_rows ? texelFetch(u_iter, p, 0).r\n"
+    "                                 : texelFetch(u_coarse, p / COARSE_DIV, 0).r;\n"
+    "  fragColor = shade(m);\n"
+    "  if (p.y < u_aa_rows){\n"
+    "    vec4 s = texelFetch(u_aa, p, 0);\n"
+    "    if (s.x >= 0.0){\n"
+    "      vec4 sum = fragColor + shade(s.x) + shade(s.y) + shade(s.z) + shade(s.w);\n"
+    "      fragColor = sum / float(" XSTR(AA_SAMPLES) " + 1);\n"
     "    }\n"
     "  }\n"
-    "  float hue = fract(m + 0.15 * sin(u_time * 0.3));\n"
-    "  vec3 col = (m == 0.0) ? vec3(0.05, 0.06, 0.08) : palette(hue);\n"
-    "  fragColor = vec4(col, 1.0);\n"
     "}\n";
 
-static GLuint compile_shader(GLenum type, const char *src) {
+// Looks each pixel up in the tile index and fetches its count from the
+// tile array; pixels under a parent stand-in read the matching sub-square.
+// Distance estimates are rescaled from tile texels to screen pixels
+// (u_de_scale for a tile of this level, more for ancestors).
+static const char *COMPOSE_FRAG_SRC =
+    "uniform highp sampler2DArray u_tiles;\n"
+    "uniform highp sampler2D u_index;\n"
+    "uniform vec2 u_view;\n"
+    "uniform float u_span;\n"
+    "uniform float u_de_scale;\n"
+    "const int TILE_SIZE = " XSTR(TILE_SIZE) ";\n"
+    "void main(){\n"
+    "  vec2 uv = v_pos;\n"
+    "  uv.x *= u_aspect;\n"
+    "  vec2 t = u_view + uv * u_span;\n"
+    "  vec4 e = texelFetch(u_index, ivec2(floor(t)), 0);\n"
+    "  vec2 r = vec2(0.0);\n"
+    "  if (e.x >= 0.0){\n"
+    "    vec2 st = e.yz + fract(t) * e.w;\n"
+    "    ivec2 texel = min(ivec2(st * float(TILE_SIZE)), ivec2(TILE_SIZE - 1));\n"
+    "    r = texelFetch(u_tiles, ivec3(texel, int(e.x)), 0).rg;\n"
+    "    r.y *= u_de_scale / e.w;\n"
+    "  }\n"
+    "  fragColor = vec4(r, 0.0, 1.0);\n"
+    "}\n";
+
+static GLuint compile_shader(GLenum type, const char *const *srcs, int count) {
   GLuint shader = glCreateShader(type);
-  glShaderSource(shader, 1, &src, NULL);
+  glShaderSource(shader, count, srcs, NULL);
   glCompileShader(shader);
   GLint ok = 0;
   glGetShaderiv(shader, GL_COMPILE_STATUS, &ok);
@@ -107,18 +616,433 @@ static GLuint link_program(GLuint vs, GLuint fs) {
   return prog;
 }
 
+// Restarts the pending reference orbit at (cx, cy).
+static void start_reference(dd cx, dd cy) {
+  if (!g_pending.orbit) {
+    g_pending.orbit = malloc((size_t)(DEEP_MAX_ITER + 1) * 2 * sizeof(float));
+    if (!g_pending.orbit) return;
+  }
+  g_pending.cx = cx;
+  g_pending.cy = cy;
+  g_pending.zx = dd_from(0.0);
+  g_pending.zy = dd_from(0.0);
+  g_pending.orbit[0] = 0.0f;
+  g_pending.orbit[1] = 0.0f;
+  g_pending.len = 1;
+  g_pending.running = 1;
+}
+
+static void upload_reference(void) {
+  int rows = (g_pending.len + ORBIT_TEX_WIDTH - 1) / ORBIT_TEX_WIDTH;
+  glBindTexture(GL_TEXTURE_2D, g_orbit_tex);
+  if (rows > g_orbit_tex_rows) {
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RG32F, ORBIT_TEX_WIDTH, rows, 0, GL_RG, GL_FLOAT, NULL);
+    g_orbit_tex_rows = rows;
+  }
+  int full_rows = g_pending.len / ORBIT_TEX_WIDTH;
+  if (full_rows > 0) {
+    glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, ORBIT_TEX_WIDTH, full_rows, GL_RG, GL_FLOAT, g_pending.orbit);
+  }
+  int tail = g_pending.len - full_rows * ORBIT_TEX_WIDTH;
+  if (tail > 0) {
+    glTexSubImage2D(GL_TEXTURE_2D, 0, 0, full_rows, tail, 1, GL_RG, GL_FLOAT,
+                    g_pending.orbit + (size_t)full_rows * ORBIT_TEX_WIDTH * 2);
+  }
+  g_ref_x = g_pending.cx;
+  g_ref_y = g_pending.cy;
+  g_ref_len = g_pending.len;
+  g_ref_serial++;
+}
+
+// Advances the pending reference by a bounded number of iterations and
+// swaps it in once it escapes or reaches DEEP_MAX_ITER.
+static void step_reference(void) {
+  RefOrbit *r = &g_pending;
+  for (int n = 0; n < ORBIT_STEPS_PER_FRAME && r->running; ++n) {
+    dd x2 = dd_sqr(r->zx);
+    dd y2 = dd_sqr(r->zy);
+    dd xy = dd_mul(r->zx, r->zy);
+    r->zx = dd_add(dd_sub(x2, y2), r->cx);
+    r->zy = dd_add(dd_add(xy, xy), r->cy);
+    r->orbit[2 * r->len] = (float)r->zx.hi;
+    r->orbit[2 * r->len + 1] = (float)r->zy.hi;
+    r->len++;
+    double mag2 = r->zx.hi * r->zx.hi + r->zy.hi * r->zy.hi;
+    if (mag2 > 4.0 || r->len > DEEP_MAX_ITER) r->running = 0;
+  }
+  if (!r->running && r->len > 0) {
+    upload_reference();
+    r->len = 0;
+  }
+}
+
+static double drift_from(dd x, dd y) {
+  double dx = dd_to_double(dd_sub(g_center_x, x)) / g_scale;
+  double dy = dd_to_double(dd_sub(g_center_y, y)) / g_scale;
+  return sqrt(dx * dx + dy * dy);
+}
+
+// Scale below which perturbation takes over: DEEP_SCALE, or wherever the
+// float tier runs out when there is no float-float tier.
+static double deep_scale(void) {
+  if (g_iter_programs[TIER_FF][PASS_PLAIN].program) return DEEP_SCALE;
+  return FF_PIXEL * 0.5 * (g_height > 0 ? g_height : 1);
+}
+
+// Keeps a reference near the view whenever deep zoom is close.
+static void update_reference(void) {
+  if (!g_iter_programs[TIER_DEEP][PASS_PLAIN].program || g_scale >= deep_scale() * 4.0) return;
+  if (g_pending.running) {
+    if (drift_from(g_pending.cx, g_pending.cy) > REF_DRIFT) start_reference(g_center_x, g_center_y);
+  } else if (g_ref_len == 0 || drift_from(g_ref_x, g_ref_y) > REF_DRIFT) {
+    start_reference(g_center_x, g_center_y);
+  }
+  if (g_pending.running) step_reference();
+}
+
+static GLuint build_program(const char *defines, const char *frag_body) {
+  const char *vs_srcs[] = {VERT_SRC};
+  const char *fs_srcs[] = {GLSL_VERSION, defines, FRAG_PRELUDE, frag_body};
+  GLuint vs = compile_shader(GL_VERTEX_SHADER, vs_srcs, 1);
+  GLuint fs = compile_shader(GL_FRAGMENT_SHADER, fs_srcs, 4);
+  return link_program(vs, fs);
+}
+
+static void delete_iteration_programs(void) {
+  for (int t = 0; t < TIER_COUNT; ++t) {
+    for (int k = 0; k < PASS_COUNT; ++k) {
+      if (g_iter_programs[t][k].program) glDeleteProgram(g_iter_programs[t][k].program);
+      g_iter_programs[t][k].program = 0;
+    }
+  }
+}
+
+// (Re)builds the iteration programs for the current g_direct setting; AA
+// passes need the float targets, so direct builds leave them out.
+static void build_iteration_programs(void) {
+  const char *const bodies[TIER_COUNT] = {FRAG_SRC, FF_FRAG_SRC, DEEP_FRAG_SRC};
+  delete_iteration_programs();
+  for (int t = 0; t < TIER_COUNT; ++t) {
+    if (t == TIER_FF && !g_ff_exact) continue;
+    for (int k = 0; k < PASS_COUNT; ++k) {
+      if (k == PASS_AA && g_direct) continue;
+      IterProgram *p = &g_iter_programs[t][k];
+      p->program = build_program(k == PASS_AA ? "#define AA\n" : g_direct ? "#define DIRECT\n" : "", bodies[t]);
+      p->time_loc = glGetUniformLocation(p->program, "u_time");
+      p->aspect_loc = glGetUniformLocation(p->program, "u_aspect");
+      p->max_iter_loc = glGetUniformLocation(p->program, "u_max_iter");
+      p->period_eps_loc = glGetUniformLocation(p->program, "u_period_eps");
+      p->pixel_loc = glGetUniformLocation(p->program, "u_pixel");
+      p->center_loc = glGetUniformLocation(p->program, "u_center");
+      p->center_lo_loc = glGetUniformLocation(p->program, "u_center_lo");
+      p->scale_loc = glGetUniformLocation(p->program, "u_scale");
+      p->one_loc = glGetUniformLocation(p->program, "u_one");
+      p->orbit_loc = glGetUniformLocation(p->program, "u_orbit");
+      p->ref_len_loc = glGetUniformLocation(p->program, "u_ref_len");
+      p->offset_loc = glGetUniformLocation(p->program, "u_ref_offset");
+      p->iter_loc = glGetUniformLocation(p->program, "u_iter");
+      p->texel_loc = glGetUniformLocation(p->program, "u_texel");
+      p->cb_parity_loc = glGetUniformLocation(p->program, "u_cb_parity");
+      p->cb_width_loc = glGetUniformLocation(p->program, "u_cb_width");
+    }
+  }
+}
+
+// Rounds a double-double to a float-float pair.
+static void split_ff(dd v, float *hi, float *lo) {
+  *hi = (float)v.hi;
+  *lo = (float)((v.hi - (double)*hi) + v.lo);
+}
+
+// Runs FF_PROBE_SRC on one pixel and reads it back (once, at init). On
+// failure the float-float programs are dropped. Needs g_vao.
+static void check_ff_precision(void) {
+  GLuint program = build_program("", FF_PROBE_SRC);
+  if (!program) return;
+  GLuint rb = 0, fbo = 0;
+  glGenRenderbuffers(1, &rb);
+  glBindRenderbuffer(GL_RENDERBUFFER, rb);
+  glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, 1, 1);
+  glGenFramebuffers(1, &fbo);
+  glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+  glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, rb);
+  float s_hi, s_lo;
+  split_ff(dd_from(1e-10), &s_hi, &s_lo);
+  glUseProgram(program);
+  glUniform1f(glGetUniformLocation(program, "u_one"), 1.0f);
+  glUniform1f(glGetUniformLocation(program, "u_center"), -0.75f);
+  glUniform2f(glGetUniformLocation(program, "u_scale"), s_hi, s_lo);
+  glUniform1f(glGetUniformLocation(program, "u_pos"), 0.3f);
+  glUniform1f(glGetUniformLocation(program, "u_square"), 1.0f + ldexpf(1.0f, -20));
+  glViewport(0, 0, 1, 1);
+  glBindVertexArray(g_vao);
+  glDrawArrays(GL_TRIANGLES, 0, 3);
+  GLubyte pixel[4] = {0, 0, 0, 0};
+  glReadPixels(0, 0, 1, 1, GL_RGBA, GL_UNSIGNED_BYTE, pixel);
+  glBindFramebuffer(GL_FRAMEBUFFER, 0);
+  glDeleteFramebuffers(1, &fbo);
+  glDeleteRenderbuffers(1, &rb);
+  glDeleteProgram(program);
+  if (pixel[1] > 128 && pixel[0] < 128) return;
+#ifdef DEBUG
+  printf("float-float shader lost its error terms; using perturbation below float precision\n");
+#endif
+  g_ff_exact = 0;
+  for (int k = 0; k < PASS_COUNT; ++k) {
+    IterProgram *p = &g_iter_programs[TIER_FF][k];
+    if (p->program) glDeleteProgram(p->program);
+    p->program = 0;
+  }
+}
+
+static void delete_target(GLuint *tex, GLuint *fbo) {
+  if (*fbo) {
+    glDeleteFramebuffers(1, fbo);
+    *fbo = 0;
+  }
+  if (*tex) {
+    glDeleteTextures(1, tex);
+    *tex = 0;
+  }
+}
+
+static void delete_iteration_target(void) {
+  delete_target(&g_iter_tex, &g_iter_fbo);
+  delete_target(&g_coarse_tex, &g_coarse_fbo);
+  delete_target(&g_aa_tex, &g_aa_fbo);
+  g_iter_w = g_iter_h = 0;
+  g_coarse_w = g_coarse_h = 0;
+  g_iter_valid = 0;
+}
+
+// (Re)allocates a float texture and a framebuffer around it; returns 0 when
+// the context cannot render to it.
+static int make_target(GLuint *tex, GLuint *fbo, int width, int height, GLenum internal, GLenum format) {
+  if (!*tex) glGenTextures(1, tex);
+  if (!*fbo) glGenFramebuffers(1, fbo);
+  glBindTexture(GL_TEXTURE_2D, *tex);
+  glTexImage2D(GL_TEXTURE_2D, 0, internal, width, height, 0, format, GL_FLOAT, NULL);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+  glBindFramebuffer(GL_FRAMEBUFFER, *fbo);
+  glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, *tex, 0);
+  GLenum status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+  glBindFramebuffer(GL_FRAMEBUFFER, 0);
+  return status == GL_FRAMEBUFFER_COMPLETE;
+}
+
+// Sizes the RG32F target (and its coarse and AA companions) to the
+// viewport. Returns 0 (and leaves no target) when the context cannot
+// render to it.
+static int resize_iteration_target(int width, int height) {
+  if (width < 1) width = 1;
+  if (height < 1) height = 1;
+  int coarse_w = (width + COARSE_DIV - 1) / COARSE_DIV;
+  int coarse_h = (height + COARSE_DIV - 1) / COARSE_DIV;
+  if (!make_target(&g_iter_tex, &g_iter_fbo, width, height, GL_RG32F, GL_RG) ||
+      !make_target(&g_coarse_tex, &g_coarse_fbo, coarse_w, coarse_h, GL_RG32F, GL_RG) ||
+      !make_target(&g_aa_tex, &g_aa_fbo, width, height, GL_RGBA16F, GL_RGBA)) {
+    delete_iteration_target();
+    return 0;
+  }
+  g_iter_w = width;
+  g_iter_h = height;
+  g_coarse_w = coarse_w;
+  g_coarse_h = coarse_h;
+  g_iter_valid = 0;
+  g_aa_rows = 0;
+  return 1;
+}
+
+// Escape-time iterations for a view of half-height `scale`: deeper views
+// need more before detail near the boundary resolves.
+static int iteration_limit(double scale) {
+  double octaves = log2(ITER_BASE_SCALE / scale);
+  int limit = ITER_BASE + (octaves > 0.0 ? (int)(ITER_PER_OCTAVE * octaves) : 0);
+  return limit < DEEP_MAX_ITER ? limit : DEEP_MAX_ITER;
+}
+
+// 1 when the context rasterizes in software (SwiftShader, llvmpipe, ...),
+// where the CPU renderer outruns the shaders.
+EM_JS(int, mandelbrot_software_gl, (), {
+  var gl = typeof GLctx !== 'undefined' ? GLctx : null;
+  if (!gl) return 0;
+  var info = gl.getExtension('WEBGL_debug_renderer_info');
+  var name = String(gl.getParameter(info ? info.UNMASKED_RENDERER_WEBGL : gl.RENDERER));
+  return /swiftshader|llvmpipe|softpipe|software|basic render/i.test(name) ? 1 : 0;
+});
+
+// Renders the view on the CPU into `tex` (width x height RG32F). The CPU
+// kernel has no distance estimate; it is left 0 (AA is off on this path).
+static void render_cpu(GLuint tex, int width, int height, float aspect, int max_iter) {
+  size_t need = (size_t)width * height;
+  if (2 * need > g_cpu_capacity) {
+    float *p = realloc(g_cpu_pixels, 2 * need * sizeof(float));
+    if (!p) return;
+    g_cpu_pixels = p;
+    g_cpu_capacity = 2 * need;
+  }
+  MandelbrotView view = {(float)g_center_x.hi, (float)g_center_y.hi, (float)g_scale, aspect, max_iter,
+                         mandelbrot_period_eps(2.0 * g_scale / height), 1};
+  // Counts land in the upper half and are spread in place to (m, 0) pairs;
+  // pair i never overwrites a count past i.
+  float *m = g_cpu_pixels + need;
+  mandelbrot_cpu_render(m, width, height, &view, 1);
+  for (size_t i = 0; i < need; ++i) {
+    g_cpu_pixels[2 * i] = m[i];
+    g_cpu_pixels[2 * i + 1] = 0.0f;
+  }
+  glBindTexture(GL_TEXTURE_2D, tex);
+  glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, width, height, GL_RG, GL_FLOAT, g_cpu_pixels);
+}
+
+static unsigned tile_hash(int level, int64_t tx, int64_t ty) {
+  uint64_t h = (uint64_t)tx * 0x9E3779B97F4A7C15ull ^ (uint64_t)ty * 0xC2B2AE3D27D4EB4Full ^ (uint64_t)level;
+  return (unsigned)(h ^ (h >> 29)) % TILE_HASH_SIZE;
+}
+
+static int tile_find(int level, int64_t tx, int64_t ty) {
+  for (int i = g_tile_hash[tile_hash(level, tx, ty)]; i >= 0; i = g_tiles[i].next) {
+    if (g_tiles[i].level == level && g_tiles[i].tx == tx && g_tiles[i].ty == ty) return i;
+  }
+  return -1;
+}
+
+static void tile_unlink(int slot) {
+  TileSlot *t = &g_tiles[slot];
+  int *link = &g_tile_hash[tile_hash(t->level, t->tx, t->ty)];
+  while (*link != slot) link = &g_tiles[*link].next;
+  *link = t->next;
+  t->used = 0;
+}
+
+// Claims a slot for (level, tx, ty): a free one, else the least recently
+// used. Returns -1 when every slot is needed this frame.
+static int tile_alloc(int level, int64_t tx, int64_t ty) {
+  int victim = -1;
+  for (int i = 0; i < g_tile_slots; ++i) {
+    if (!g_tiles[i].used) {
+      victim = i;
+      break;
+    }
+    if (g_tiles[i].last_used != g_tile_frame &&
+        (victim < 0 || g_tiles[i].last_used < g_tiles[victim].last_used)) {
+      victim = i;
+    }
+  }
+  if (victim < 0) return -1;
+  if (g_tiles[victim].used) tile_unlink(victim);
+  TileSlot *t = &g_tiles[victim];
+  unsigned h = tile_hash(level, tx, ty);
+  t->level = level;
+  t->tx = tx;
+  t->ty = ty;
+  t->last_used = g_tile_frame;
+  t->used = 1;
+  t->next = g_tile_hash[h];
+  g_tile_hash[h] = victim;
+  return victim;
+}
+
+static void delete_tiles(void) {
+  if (g_tile_fbo) {
+    glDeleteFramebuffers(1, &g_tile_fbo);
+    g_tile_fbo = 0;
+  }
+  if (g_tile_tex) {
+    glDeleteTextures(1, &g_tile_tex);
+    g_tile_tex = 0;
+  }
+  if (g_index_tex) {
+    glDeleteTextures(1, &g_index_tex);
+    g_index_tex = 0;
+  }
+  free(g_tiles);
+  g_tiles = NULL;
+  g_tile_slots = 0;
+  g_tiles_pending = 0;
+}
+
+// Allocates as many tile layers as g_tile_budget_mb allows. On failure the
+// cache stays off and the float tier renders full-screen passes.
+static void create_tiles(void) {
+  delete_tiles();
+  GLint max_layers = 0;
+  glGetIntegerv(GL_MAX_ARRAY_TEXTURE_LAYERS, &max_layers);
+  int slots = (int)((size_t)g_tile_budget_mb * 1024 * 1024 / ((size_t)TILE_SIZE * TILE_SIZE * 2 * sizeof(float)));
+  if (slots > max_layers) slots = max_layers;
+  if (slots < 16) return;
+  g_tiles = calloc((size_t)slots, sizeof *g_tiles);
+  if (!g_tiles) return;
+  for (int i = 0; i < TILE_HASH_SIZE; ++i) g_tile_hash[i] = -1;
+
+  glGenTextures(1, &g_tile_tex);
+  glBindTexture(GL_TEXTURE_2D_ARRAY, g_tile_tex);
+  glTexStorage3D(GL_TEXTURE_2D_ARRAY, 1, GL_RG32F, TILE_SIZE, TILE_SIZE, slots);
+  glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+  glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+  glGenFramebuffers(1, &g_tile_fbo);
+  glBindFramebuffer(GL_FRAMEBUFFER, g_tile_fbo);
+  glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, g_tile_tex, 0, 0);
+  GLenum status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+  glBindFramebuffer(GL_FRAMEBUFFER, 0);
+  if (status != GL_FRAMEBUFFER_COMPLETE || glGetError() != GL_NO_ERROR) {
+    delete_tiles();
+    return;
+  }
+
+  glGenTextures(1, &g_index_tex);
+  glBindTexture(GL_TEXTURE_2D, g_index_tex);
+  glTexStorage2D(GL_TEXTURE_2D, 1, GL_RGBA32F, TILE_INDEX_MAX, TILE_INDEX_MAX);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+  g_tile_slots = slots;
+}
+
 void demo_app_init(int width, int height) {
   g_width = width;
   g_height = height;
   g_active = 0;
 
-  GLuint vs = compile_shader(GL_VERTEX_SHADER, VERT_SRC);
-  GLuint fs = compile_shader(GL_FRAGMENT_SHADER, FRAG_SRC);
-  g_program = link_program(vs, fs);
-  g_time_loc = glGetUniformLocation(g_program, "u_time");
-  g_aspect_loc = glGetUniformLocation(g_program, "u_aspect");
-  g_center_loc = glGetUniformLocation(g_program, "u_center");
-  g_scale_loc = glGetUniformLocation(g_program, "u_scale");
+  // Float color attachments need EXT_color_buffer_float in WebGL2.
+  EMSCRIPTEN_WEBGL_CONTEXT_HANDLE ctx = emscripten_webgl_get_current_context();
+  g_direct = !emscripten_webgl_enable_extension(ctx, "EXT_color_buffer_float") ||
+             !resize_iteration_target(width, height);
+  build_iteration_programs();
+  if (g_direct) g_cb_ready = checkerboard_init(&g_cb);
+  if (!g_direct) {
+    g_palette_program = build_program("", PALETTE_FRAG_SRC);
+    g_palette_time_loc = glGetUniformLocation(g_palette_program, "u_time");
+    g_palette_iter_loc = glGetUniformLocation(g_palette_program, "u_iter");
+    g_palette_coarse_loc = glGetUniformLocation(g_palette_program, "u_coarse");
+    g_palette_refined_loc = glGetUniformLocation(g_palette_program, "u_refined_rows");
+    g_palette_aa_loc = glGetUniformLocation(g_palette_program, "u_aa");
+    g_palette_aa_rows_loc = glGetUniformLocation(g_palette_program, "u_aa_rows");
+    g_compose_program = build_program("", COMPOSE_FRAG_SRC);
+    g_compose_tiles_loc = glGetUniformLocation(g_compose_program, "u_tiles");
+    g_compose_index_loc = glGetUniformLocation(g_compose_program, "u_index");
+    g_compose_aspect_loc = glGetUniformLocation(g_compose_program, "u_aspect");
+    g_compose_view_loc = glGetUniformLocation(g_compose_program, "u_view");
+    g_compose_span_loc = glGetUniformLocation(g_compose_program, "u_span");
+    g_compose_de_scale_loc = glGetUniformLocation(g_compose_program, "u_de_scale");
+    create_tiles();
+    if (emscripten_webgl_enable_extension(ctx, "EXT_disjoint_timer_query_webgl2")) {
+      glGenQueries(1, &g_timer_query);
+    }
+    workpool_start(0);
+    g_cpu = mandelbrot_software_gl();
+  }
+
+  glGenTextures(1, &g_orbit_tex);
+  glBindTexture(GL_TEXTURE_2D, g_orbit_tex);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+  g_orbit_tex_rows = 0;
+  g_ref_len = 0;
 
   const GLfloat verts[] = {
       -1.0f, -1.0f,
@@ -136,47 +1060,481 @@ void demo_app_init(int width, int height) {
   glEnableVertexAttribArray(0);
   glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 2 * sizeof(GLfloat), (void *)0);
 
+  check_ff_precision();
   demo_app_resize(width, height);
 }
 
 void demo_app_resize(int width, int height) {
   g_width = width;
   g_height = height;
+  if (!g_direct && (width != g_iter_w || height != g_iter_h) && !resize_iteration_target(width, height)) {
+    // Lost the float target (should not happen once it worked): fall back
+    // to coloring in the iteration shaders.
+    g_direct = 1;
+    g_cpu = 0;
+    delete_tiles();
+    build_iteration_programs();
+    g_cb_ready = checkerboard_init(&g_cb);
+  }
+  if (g_cb_ready && !checkerboard_resize(&g_cb, width, height)) {
+    checkerboard_shutdown(&g_cb);
+    g_cb_ready = 0;
+  }
+  g_redraw = 1;
   glViewport(0, 0, g_width, g_height);
 }
 
-void demo_app_frame(double time_sec, double dt_sec) {
-  if (!g_active) return;
+// Binds `p` and sets what every tier takes. `pixel` is the pixel size in
+// the plane, for the cycle tolerance and the distance estimate.
+static void use_iteration(const IterProgram *p, float time_sec, float aspect, double pixel, int max_iter) {
+  glUseProgram(p->program);
+  if (p->time_loc >= 0) glUniform1f(p->time_loc, time_sec);
+  if (p->aspect_loc >= 0) glUniform1f(p->aspect_loc, aspect);
+  if (p->max_iter_loc >= 0) glUniform1i(p->max_iter_loc, max_iter);
+  if (p->period_eps_loc >= 0) glUniform1f(p->period_eps_loc, mandelbrot_period_eps(pixel));
+  if (p->pixel_loc >= 0) glUniform1f(p->pixel_loc, (float)pixel);
+  if (g_cb_pass) {
+    checkerboard_set_uniforms(&g_cb, p->cb_parity_loc, p->cb_width_loc);
+  } else if (p->cb_parity_loc >= 0) {
+    glUniform1i(p->cb_parity_loc, -1);
+  }
+}
+
+static void use_float(const IterProgram *p, float time_sec, float aspect, dd cx, dd cy, double scale, double pixel,
+                      int max_iter) {
+  use_iteration(p, time_sec, aspect, pixel, max_iter);
+  if (p->center_loc >= 0) glUniform2f(p->center_loc, (float)cx.hi, (float)cy.hi);
+  if (p->scale_loc >= 0) glUniform1f(p->scale_loc, (float)scale);
+}
+
+static void use_ff(const IterProgram *p, float time_sec, float aspect, dd cx, dd cy, double scale, double pixel,
+                   int max_iter) {
+  float cx_hi, cx_lo, cy_hi, cy_lo, s_hi, s_lo;
+  split_ff(cx, &cx_hi, &cx_lo);
+  split_ff(cy, &cy_hi, &cy_lo);
+  split_ff(dd_from(scale), &s_hi, &s_lo);
+  use_iteration(p, time_sec, aspect, pixel, max_iter);
+  if (p->one_loc >= 0) glUniform1f(p->one_loc, 1.0f);
+  if (p->center_loc >= 0) glUniform2f(p->center_loc, cx_hi, cy_hi);
+  if (p->center_lo_loc >= 0) glUniform2f(p->center_lo_loc, cx_lo, cy_lo);
+  if (p->scale_loc >= 0) glUniform2f(p->scale_loc, s_hi, s_lo);
+}
+
+// Cheapest non-perturbation tier that resolves pixels of this size.
+static int pixel_tier(double pixel) {
+  return (pixel < FF_PIXEL && g_iter_programs[TIER_FF][PASS_PLAIN].program) ? TIER_FF : TIER_FLOAT;
+}
+
+static void use_deep(const IterProgram *p, float time_sec, float aspect, double pixel, int max_iter) {
+  // Deltas and the derivative are in units of g_scale, and so is u_pixel.
+  use_iteration(p, time_sec, aspect, pixel / g_scale, max_iter);
+  glActiveTexture(GL_TEXTURE0);
+  glBindTexture(GL_TEXTURE_2D, g_orbit_tex);
+  if (p->orbit_loc >= 0) glUniform1i(p->orbit_loc, 0);
+  if (p->ref_len_loc >= 0) glUniform1i(p->ref_len_loc, g_ref_len);
+  // Offset of the view center from the reference, in units of g_scale;
+  // the subtraction happens in double-double before rounding to float.
+  float off_x = (float)(dd_to_double(dd_sub(g_center_x, g_ref_x)) / g_scale);
+  float off_y = (float)(dd_to_double(dd_sub(g_center_y, g_ref_y)) / g_scale);
+  if (p->offset_loc >= 0) glUniform2f(p->offset_loc, off_x, off_y);
+  if (p->scale_loc >= 0) glUniform1f(p->scale_loc, (float)g_scale);
+}
+
+// Renders the float program over one tile: aspect 1, centered on the tile.
+static void render_tile(int slot, int level, int64_t tx, int64_t ty, float time_sec) {
+  double w = ldexp(TILE_WORLD, -level);
+  glBindFramebuffer(GL_FRAMEBUFFER, g_tile_fbo);
+  glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, g_tile_tex, 0, slot);
+  glViewport(0, 0, TILE_SIZE, TILE_SIZE);
+  dd cx = dd_from(((double)tx + 0.5) * w);
+  dd cy = dd_from(((double)ty + 0.5) * w);
+  // The tier follows the level, so a tile's contents never depend on the
+  // view it was first rendered for.
+  int tier = pixel_tier(w / TILE_SIZE);
+  const IterProgram *p = &g_iter_programs[tier][PASS_PLAIN];
+  if (tier == TIER_FF) {
+    use_ff(p, time_sec, 1.0f, cx, cy, w * 0.5, w / TILE_SIZE, iteration_limit(w * 0.5));
+  } else {
+    use_float(p, time_sec, 1.0f, cx, cy, w * 0.5, w / TILE_SIZE, iteration_limit(w * 0.5));
+  }
+  glBindVertexArray(g_vao);
+  glDrawArrays(GL_TRIANGLES, 0, 3);
+}
+
+static int64_t floor_shift(int64_t v, int k) {
+  return v >= 0 ? v >> k : -((-v - 1) >> k) - 1;
+}
+
+typedef struct {
+  int64_t tx, ty;
+  double dist;
+} MissingTile;
+
+static int compare_missing(const void *a, const void *b) {
+  double da = ((const MissingTile *)a)->dist;
+  double db = ((const MissingTile *)b)->dist;
+  return (da > db) - (da < db);
+}
+
+// Composes a float or float-float view into g_iter_fbo from cached tiles. Up to
+// `budget` missing tiles are rendered, nearest the center first; the rest
+// show a cached ancestor until they arrive (g_tiles_pending). Returns the
+// pixels rendered.
+static double compose_tiles(float time_sec, float aspect, int budget) {
+  g_tile_frame++;
+
+  // Finest level whose texels are no larger than a screen pixel, backed
+  // off while the view would need more tiles than the index holds.
+  double pixel = 2.0 * g_scale / (g_height > 0 ? g_height : 1);
+  int level = (int)ceil(log2(TILE_WORLD / (TILE_SIZE * pixel)));
+  if (level < 0) level = 0;
+  double cx = g_center_x.hi, cy = g_center_y.hi;
+  double half_x = g_scale * aspect, half_y = g_scale;
+  double w;
+  int64_t tx0, ty0;
+  int cols, rows;
+  for (;;) {
+    w = ldexp(TILE_WORLD, -level);
+    tx0 = (int64_t)floor((cx - half_x) / w);
+    ty0 = (int64_t)floor((cy - half_y) / w);
+    cols = (int)((int64_t)floor((cx + half_x) / w) - tx0 + 1);
+    rows = (int)((int64_t)floor((cy + half_y) / w) - ty0 + 1);
+    if ((cols <= TILE_INDEX_MAX && rows <= TILE_INDEX_MAX) || level == 0) break;
+    level--;
+  }
+  if (cols > TILE_INDEX_MAX) cols = TILE_INDEX_MAX;
+  if (rows > TILE_INDEX_MAX) rows = TILE_INDEX_MAX;
+
+  static MissingTile missing[TILE_INDEX_MAX * TILE_INDEX_MAX];
+  int missing_count = 0;
+  for (int j = 0; j < rows; ++j) {
+    for (int i = 0; i < cols; ++i) {
+      int slot = tile_find(level, tx0 + i, ty0 + j);
+      if (slot >= 0) {
+        g_tiles[slot].last_used = g_tile_frame;
+        continue;
+      }
+      MissingTile *m = &missing[missing_count++];
+      m->tx = tx0 + i;
+      m->ty = ty0 + j;
+      double dx = ((double)m->tx + 0.5) * w - cx;
+      double dy = ((double)m->ty + 0.5) * w - cy;
+      m->dist = dx * dx + dy * dy;
+    }
+  }
+  qsort(missing, (size_t)missing_count, sizeof *missing, compare_missing);
+  // When the budget cannot hold the whole view, the leftovers keep their
+  // stand-ins rather than thrashing.
+  int rendered = 0;
+  int full = 0;
+  for (; rendered < missing_count && rendered < budget; ++rendered) {
+    int slot = tile_alloc(level, missing[rendered].tx, missing[rendered].ty);
+    if (slot < 0) {
+      full = 1;
+      break;
+    }
+    render_tile(slot, level, missing[rendered].tx, missing[rendered].ty, time_sec);
+  }
+  g_tiles_pending = !full && rendered < missing_count;
+
+  for (int j = 0; j < rows; ++j) {
+    for (int i = 0; i < cols; ++i) {
+      float *e = &g_index_data[4 * (j * TILE_INDEX_MAX + i)];
+      e[0] = -1.0f;
+      for (int k = 0; k <= TILE_PARENT_LEVELS && k <= level; ++k) {
+        int64_t px = floor_shift(tx0 + i, k);
+        int64_t py = floor_shift(ty0 + j, k);
+        int slot = tile_find(level - k, px, py);
+        if (slot < 0) continue;
+        g_tiles[slot].last_used = g_tile_frame;
+        float extent = ldexpf(1.0f, -k);
+        e[0] = (float)slot;
+        e[1] = (float)(tx0 + i - (px << k)) * extent;
+        e[2] = (float)(ty0 + j - (py << k)) * extent;
+        e[3] = extent;
+        break;
+      }
+    }
+  }
+  glActiveTexture(GL_TEXTURE1);
+  glBindTexture(GL_TEXTURE_2D, g_index_tex);
+  glPixelStorei(GL_UNPACK_ROW_LENGTH, TILE_INDEX_MAX);
+  glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, cols, rows, GL_RGBA, GL_FLOAT, g_index_data);
+  glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+
+  glBindFramebuffer(GL_FRAMEBUFFER, g_iter_fbo);
+  glViewport(0, 0, g_iter_w, g_iter_h);
+  glUseProgram(g_compose_program);
+  glActiveTexture(GL_TEXTURE0);
+  glBindTexture(GL_TEXTURE_2D_ARRAY, g_tile_tex);
+  if (g_compose_tiles_loc >= 0) glUniform1i(g_compose_tiles_loc, 0);
+  if (g_compose_index_loc >= 0) glUniform1i(g_compose_index_loc, 1);
+  if (g_compose_aspect_loc >= 0) glUniform1f(g_compose_aspect_loc, aspect);
+  // View center and half-height in tile units, relative to tile (tx0, ty0).
+  if (g_compose_view_loc >= 0) {
+    glUniform2f(g_compose_view_loc, (float)(cx / w - (double)tx0), (float)(cy / w - (double)ty0));
+  }
+  if (g_compose_span_loc >= 0) glUniform1f(g_compose_span_loc, (float)(g_scale / w));
+  if (g_compose_de_scale_loc >= 0) glUniform1f(g_compose_de_scale_loc, (float)(w / TILE_SIZE / pixel));
+  glBindVertexArray(g_vao);
+  glDrawArrays(GL_TRIANGLES, 0, 3);
+  return (double)rendered * TILE_SIZE * TILE_SIZE;
+}
+
+static int same_view(const ViewKey *a, const ViewKey *b) {
+  return a->cx.hi == b->cx.hi && a->cx.lo == b->cx.lo && a->cy.hi == b->cy.hi && a->cy.lo == b->cy.lo &&
+         a->scale == b->scale && a->tier == b->tier && a->ref_serial == b->ref_serial &&
+         a->width == b->width && a->height == b->height;
+}
+
+static void draw_iterations(float time_sec, float aspect, int tier, int pass, int max_iter) {
+  // Full-resolution pixel size; coarse passes get the tighter tolerance
+  // and distance estimates in full-resolution pixels.
+  double pixel = 2.0 * g_scale / (g_height > 0 ? g_height : 1);
+  const IterProgram *p = &g_iter_programs[tier][pass];
+  if (tier == TIER_DEEP) {
+    use_deep(p, time_sec, aspect, pixel, max_iter);
+  } else if (tier == TIER_FF) {
+    use_ff(p, time_sec, aspect, g_center_x, g_center_y, g_scale, pixel, max_iter);
+  } else {
+    use_float(p, time_sec, aspect, g_center_x, g_center_y, g_scale, pixel, max_iter);
+  }
+  if (pass == PASS_AA) {
+    glActiveTexture(GL_TEXTURE2);
+    glBindTexture(GL_TEXTURE_2D, g_iter_tex);
+    if (p->iter_loc >= 0) glUniform1i(p->iter_loc, 2);
+    if (p->texel_loc >= 0) glUniform2f(p->texel_loc, 2.0f / (float)g_iter_w, 2.0f / (float)g_iter_h);
+  }
+  glBindVertexArray(g_vao);
+  glDrawArrays(GL_TRIANGLES, 0, 3);
+}
+
+// Reads back the last refinement timing and steers g_refine_pixels toward
+// REFINE_BUDGET_MS.
+static void update_refine_budget(double dt_sec) {
+  if (g_timer_query) {
+    if (!g_timer_pending) return;
+    GLuint available = 0;
+    glGetQueryObjectuiv(g_timer_query, GL_QUERY_RESULT_AVAILABLE, &available);
+    GLint disjoint = 0;
+    glGetIntegerv(GL_GPU_DISJOINT_EXT, &disjoint);
+    if (!available && !disjoint) return;
+    g_timer_pending = 0;
+    if (!available || disjoint) return;
+    GLuint ns = 0;
+    glGetQueryObjectuiv(g_timer_query, GL_QUERY_RESULT, &ns);
+    double ms = (double)ns * 1e-6;
+    if (ms > 0.0) {
+      double target = g_timer_pixels * REFINE_BUDGET_MS / ms;
+      g_refine_pixels += 0.3 * (target - g_refine_pixels);
+    }
+  } else if (g_refine_last > 0.0) {
+    if (dt_sec > 1.0 / 50.0) {
+      g_refine_pixels *= 0.7;
+    } else if (dt_sec < 1.0 / 57.0) {
+      g_refine_pixels *= 1.1;
+    }
+  }
+  if (g_refine_pixels < REFINE_MIN_PIXELS) g_refine_pixels = REFINE_MIN_PIXELS;
+  if (g_refine_pixels > REFINE_MAX_PIXELS) g_refine_pixels = REFINE_MAX_PIXELS;
+}
+
+static void begin_refine_timer(void) {
+  if (g_timer_query && !g_timer_pending) glBeginQuery(GL_TIME_ELAPSED_EXT, g_timer_query);
+}
+
+static void end_refine_timer(double pixels) {
+  g_refine_last = pixels;
+  if (g_timer_query && !g_timer_pending) {
+    glEndQuery(GL_TIME_ELAPSED_EXT);
+    g_timer_pending = pixels > 0.0;
+    g_timer_pixels = pixels;
+  }
+}
+
+// Refines the next band of rows of the iteration target at full resolution
+// and limit. Returns the pixels rendered.
+static double refine_rows(float time_sec, float aspect, int tier, int max_iter) {
+  int rows = (int)(g_refine_pixels / g_iter_w);
+  if (rows < 1) rows = 1;
+  if (rows > g_iter_h - g_refined_rows) rows = g_iter_h - g_refined_rows;
+  glBindFramebuffer(GL_FRAMEBUFFER, g_iter_fbo);
+  glViewport(0, 0, g_iter_w, g_iter_h);
+  glEnable(GL_SCISSOR_TEST);
+  glScissor(0, g_refined_rows, g_iter_w, rows);
+  draw_iterations(time_sec, aspect, tier, PASS_PLAIN, max_iter);
+  glDisable(GL_SCISSOR_TEST);
+  g_refined_rows += rows;
+  return (double)rows * g_iter_w;
+}
+
+// Runs the AA pass over the next band of rows of a fully refined view;
+// every pixel of the band is budgeted as AA_SAMPLES, as if it were an
+// edge. Returns the pixels (samples) budgeted.
+static double antialias_rows(float time_sec, float aspect, int tier, int max_iter) {
+  int rows = (int)(g_refine_pixels / ((double)AA_SAMPLES * g_iter_w));
+  if (rows < 1) rows = 1;
+  if (rows > g_iter_h - g_aa_rows) rows = g_iter_h - g_aa_rows;
+  glBindFramebuffer(GL_FRAMEBUFFER, g_aa_fbo);
+  glViewport(0, 0, g_iter_w, g_iter_h);
+  glEnable(GL_SCISSOR_TEST);
+  glScissor(0, g_aa_rows, g_iter_w, rows);
+  draw_iterations(time_sec, aspect, tier, PASS_AA, max_iter);
+  glDisable(GL_SCISSOR_TEST);
+  g_aa_rows += rows;
+  return (double)rows * g_iter_w * AA_SAMPLES;
+}
+
+// Whether the current view still has refinement, tiles or AA bands left.
+static int view_pending(int tiled, int aa) {
+  if (tiled && !g_cpu && g_tiles_pending) return 1;
+  if (g_refined_rows < g_iter_h) return 1;
+  return aa && g_aa_rows < g_iter_h;
+}
+
+int demo_app_frame(double time_sec, double dt_sec) {
+  if (!g_active) return 0;
+  if (g_animate) g_palette_time = time_sec;
+  time_sec = g_palette_time;
 
   float aspect = (g_height > 0) ? ((float)g_width / (float)g_height) : 1.0f;
-  float pan_speed = g_scale * 0.6f;
-  if (g_key_left) g_center_x -= pan_speed * (float)dt_sec;
-  if (g_key_right) g_center_x += pan_speed * (float)dt_sec;
-  if (g_key_up) g_center_y += pan_speed * (float)dt_sec;
-  if (g_key_down) g_center_y -= pan_speed * (float)dt_sec;
-
-  float zoom_rate = 1.6f;
-  if (g_key_zoom_in) g_scale *= expf(-zoom_rate * (float)dt_sec);
-  if (g_key_zoom_out) g_scale *= expf(zoom_rate * (float)dt_sec);
-  if (g_scale < 0.0002f) g_scale = 0.0002f;
-  if (g_scale > 4.0f) g_scale = 4.0f;
+  double pan_speed = g_scale * 0.6;
+  if (g_key_left) g_center_x = dd_add_d(g_center_x, -pan_speed * dt_sec);
+  if (g_key_right) g_center_x = dd_add_d(g_center_x, pan_speed * dt_sec);
+  if (g_key_up) g_center_y = dd_add_d(g_center_y, pan_speed * dt_sec);
+  if (g_key_down) g_center_y = dd_add_d(g_center_y, -pan_speed * dt_sec);
+
+  double zoom_rate = 1.6;
+  double min_scale = g_cpu                                                ? FLOAT_MIN_SCALE
+                     : g_iter_programs[TIER_DEEP][PASS_PLAIN].program ? DEEP_MIN_SCALE
+                     : g_iter_programs[TIER_FF][PASS_PLAIN].program   ? DEEP_SCALE
+                                                                      : FLOAT_MIN_SCALE;
+  if (g_key_zoom_in) g_scale *= exp(-zoom_rate * dt_sec);
+  if (g_key_zoom_out) g_scale *= exp(zoom_rate * dt_sec);
+  if (g_scale < min_scale) g_scale = min_scale;
+  if (g_scale > MAX_SCALE) g_scale = MAX_SCALE;
+
+  update_reference();
+  update_refine_budget(dt_sec);
 
   glDisable(GL_DEPTH_TEST);
-  glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
-  glClear(GL_COLOR_BUFFER_BIT);
 
-  glUseProgram(g_program);
-  if (g_aspect_loc >= 0) glUniform1f(g_aspect_loc, aspect);
-  if (g_time_loc >= 0) glUniform1f(g_time_loc, (float)time_sec);
-  if (g_center_loc >= 0) glUniform2f(g_center_loc, g_center_x, g_center_y);
-  if (g_scale_loc >= 0) glUniform1f(g_scale_loc, g_scale);
+  // Until the first reference is ready the float-float shader keeps
+  // drawing, blurry but responsive.
+  int tier = g_cpu ? TIER_FLOAT : pixel_tier(2.0 * g_scale / (g_height > 0 ? g_height : 1));
+  if (!g_cpu && g_scale < deep_scale() && g_ref_len > 0) tier = TIER_DEEP;
+  int deep = tier == TIER_DEEP;
+  int max_iter = iteration_limit(g_scale);
+  int coarse_iter = max_iter / 4 > ITER_BASE ? max_iter / 4 : ITER_BASE;
+  ViewKey view = {g_center_x, g_center_y, g_scale, tier, deep ? g_ref_serial : 0, g_width, g_height};
+  int moved = !g_iter_valid || !same_view(&view, &g_iter_view);
+  g_still_frames = moved ? 0 : g_still_frames + 1;
+  int tiled = !deep && g_tile_slots > 0 && g_compose_program;
+  // The CPU kernel has no distance estimate, so no AA there.
+  int aa = g_aa && !g_cpu && g_iter_programs[tier][PASS_AA].program;
+  // The direct path is final one frame after the view stops (two with the
+  // checkerboard, one per half); the others once refinement is done.
+  int settle = g_checkerboard && g_cb_ready ? 2 : 1;
+  int keys = g_key_left || g_key_right || g_key_up || g_key_down || g_key_zoom_in || g_key_zoom_out;
+  int busy = keys || g_animate || g_pending.running || (g_direct ? g_still_frames <= settle : view_pending(tiled, aa));
+  if (!moved && !busy && !g_redraw) return 0;
+  g_redraw = 0;
+
+  if (g_direct) {
+    // No float targets to refine into: only the iteration cap drops while
+    // the view moves.
+    g_cb_pass = g_checkerboard && g_cb_ready;
+    if (g_cb_pass) {
+      checkerboard_begin(&g_cb);
+    } else {
+      glViewport(0, 0, g_width, g_height);
+    }
+    draw_iterations((float)time_sec, aspect, tier, PASS_PLAIN, moved ? coarse_iter : max_iter);
+    if (g_cb_pass) {
+      // Last frame's NDC for each pixel: the plane point it shows now, seen
+      // through the previous view.
+      float reproject[4] = {1.0f, 1.0f, 0.0f, 0.0f};
+      if (g_iter_valid && g_iter_view.width == g_width && g_iter_view.height == g_height) {
+        double prev = g_iter_view.scale;
+        reproject[0] = reproject[1] = (float)(g_scale / prev);
+        reproject[2] = (float)(dd_to_double(dd_sub(g_center_x, g_iter_view.cx)) / prev / aspect);
+        reproject[3] = (float)(dd_to_double(dd_sub(g_center_y, g_iter_view.cy)) / prev);
+      } else {
+        checkerboard_invalidate(&g_cb);
+      }
+      checkerboard_resolve(&g_cb, reproject);
+      g_cb_pass = 0;
+    }
+    g_iter_view = view;
+    g_iter_valid = 1;
+    int again = keys || moved || g_animate || g_pending.running || g_still_frames < settle;
+    // A resize now would drop the checkerboard history the still view is
+    // being resolved from.
+    int refining = !moved && g_still_frames < settle;
+    return DEMO_FRAME_DRAWN | (again ? DEMO_FRAME_AGAIN : 0) | (refining ? DEMO_FRAME_REFINING : 0);
+  }
+
+  double refined = 0.0;
+  if (moved || !aa) g_aa_rows = 0;
+  begin_refine_timer();
+  if (g_cpu) {
+    // Coarse while moving, then the full frame in one go.
+    if (moved) {
+      render_cpu(g_coarse_tex, g_coarse_w, g_coarse_h, aspect, coarse_iter);
+      g_refined_rows = 0;
+    } else if (g_refined_rows < g_iter_h) {
+      render_cpu(g_iter_tex, g_iter_w, g_iter_h, aspect, max_iter);
+      g_refined_rows = g_iter_h;
+    }
+  } else if (tiled && (moved || g_tiles_pending)) {
+    // Parent tiles are the coarse stand-ins; the budget only paces how many
+    // missing tiles are filled in per frame.
+    int budget = (int)(g_refine_pixels / ((double)TILE_SIZE * TILE_SIZE));
+    refined = compose_tiles((float)time_sec, aspect, budget > 0 ? budget : 1);
+    g_refined_rows = g_iter_h;
+    g_aa_rows = 0;
+  } else if (moved) {
+    glBindFramebuffer(GL_FRAMEBUFFER, g_coarse_fbo);
+    glViewport(0, 0, g_coarse_w, g_coarse_h);
+    draw_iterations((float)time_sec, aspect, tier, PASS_PLAIN, coarse_iter);
+    g_refined_rows = 0;
+  } else if (g_refined_rows < g_iter_h) {
+    refined = refine_rows((float)time_sec, aspect, tier, max_iter);
+  } else if (aa && g_aa_rows < g_iter_h) {
+    // Refined and settled: edge pixels get their extra samples.
+    refined = antialias_rows((float)time_sec, aspect, tier, max_iter);
+  }
+  end_refine_timer(refined);
+  glBindFramebuffer(GL_FRAMEBUFFER, 0);
+  g_iter_view = view;
+  g_iter_valid = 1;
 
+  glViewport(0, 0, g_width, g_height);
+  glUseProgram(g_palette_program);
+  glActiveTexture(GL_TEXTURE0);
+  glBindTexture(GL_TEXTURE_2D, g_iter_tex);
+  glActiveTexture(GL_TEXTURE1);
+  glBindTexture(GL_TEXTURE_2D, g_coarse_tex);
+  glActiveTexture(GL_TEXTURE2);
+  glBindTexture(GL_TEXTURE_2D, g_aa_tex);
+  if (g_palette_iter_loc >= 0) glUniform1i(g_palette_iter_loc, 0);
+  if (g_palette_coarse_loc >= 0) glUniform1i(g_palette_coarse_loc, 1);
+  if (g_palette_aa_loc >= 0) glUniform1i(g_palette_aa_loc, 2);
+  if (g_palette_refined_loc >= 0) glUniform1i(g_palette_refined_loc, g_refined_rows);
+  if (g_palette_aa_rows_loc >= 0) glUniform1i(g_palette_aa_rows_loc, g_aa_rows);
+  if (g_palette_time_loc >= 0) glUniform1f(g_palette_time_loc, (float)time_sec);
   glBindVertexArray(g_vao);
   glDrawArrays(GL_TRIANGLES, 0, 3);
+  int pending = view_pending(tiled, aa);
+  busy = keys || g_animate || g_pending.running || pending;
+  // Rescaling would rebuild the iteration target and restart refinement
+  // from the coarse pass, so the scale waits for a finished view.
+  return DEMO_FRAME_DRAWN | (busy ? DEMO_FRAME_AGAIN : 0) | (pending && !moved ? DEMO_FRAME_REFINING : 0);
 }
 
 void demo_app_set_active(int active) {
   g_active = active ? 1 : 0;
+  g_redraw = 1;
   if (!g_active) {
     g_key_left = g_key_right = g_key_up = g_key_down = 0;
     g_key_zoom_in = g_key_zoom_out = 0;
@@ -192,10 +1550,37 @@ void demo_app_shutdown(void) {
     glDeleteVertexArrays(1, &g_vao);
     g_vao = 0;
   }
-  if (g_program) {
-    glDeleteProgram(g_program);
-    g_program = 0;
+  delete_iteration_programs();
+  if (g_palette_program) {
+    glDeleteProgram(g_palette_program);
+    g_palette_program = 0;
+  }
+  if (g_compose_program) {
+    glDeleteProgram(g_compose_program);
+    g_compose_program = 0;
+  }
+  delete_tiles();
+  delete_iteration_target();
+  if (g_cb_ready) {
+    checkerboard_shutdown(&g_cb);
+    g_cb_ready = 0;
+  }
+  if (g_timer_query) {
+    glDeleteQueries(1, &g_timer_query);
+    g_timer_query = 0;
+    g_timer_pending = 0;
+  }
+  if (g_orbit_tex) {
+    glDeleteTextures(1, &g_orbit_tex);
+    g_orbit_tex = 0;
+    g_orbit_tex_rows = 0;
   }
+  free(g_pending.orbit);
+  memset(&g_pending, 0, sizeof g_pending);
+  free(g_cpu_pixels);
+  g_cpu_pixels = NULL;
+  g_cpu_capacity = 0;
+  g_ref_len = 0;
 }
 
 void demo_app_handle_key(int key, int pressed) {
@@ -213,3 +1598,71 @@ void demo_app_handle_key(int key, int pressed) {
 void demo_app_update_mouse(float x, float y, int present) {
   (void)x; (void)y; (void)present;
 }
+
+// GPU memory for cached tiles, in MB; rebuilding the cache drops every tile.
+EMSCRIPTEN_KEEPALIVE int mandelbrot_set_tile_budget_mb(int mb) {
+  if (mb < 4) mb = 4;
+  if (mb > 512) mb = 512;
+  g_tile_budget_mb = mb;
+  if (g_compose_program) {
+    create_tiles();
+    g_iter_valid = 0;
+    runtime_request_frame(0.0);
+  }
+  return g_tile_budget_mb;
+}
+
+EMSCRIPTEN_KEEPALIVE int mandelbrot_get_tile_budget_mb(void) {
+  return g_tile_budget_mb;
+}
+
+// 1 renders on the CPU worker pool instead of the shaders (needs the float
+// targets); turned on automatically for software GL.
+EMSCRIPTEN_KEEPALIVE int mandelbrot_set_cpu(int enabled) {
+  g_cpu = (enabled && g_palette_program) ? 1 : 0;
+  g_iter_valid = 0;
+  runtime_request_frame(0.0);
+  return g_cpu;
+}
+
+EMSCRIPTEN_KEEPALIVE int mandelbrot_get_cpu(void) {
+  return g_cpu;
+}
+
+// 1 (the default) adds jittered samples to edge pixels once a view settles.
+EMSCRIPTEN_KEEPALIVE int mandelbrot_set_aa(int enabled) {
+  g_aa = enabled ? 1 : 0;
+  g_redraw = 1;
+  runtime_request_frame(0.0);
+  return g_aa;
+}
+
+EMSCRIPTEN_KEEPALIVE int mandelbrot_get_aa(void) {
+  return g_aa;
+}
+
+// 1 (the default) shades half the pixels per frame on the direct path (no
+// float render targets) and reprojects the rest from the last frame.
+EMSCRIPTEN_KEEPALIVE int mandelbrot_set_checkerboard(int enabled) {
+  g_checkerboard = enabled ? 1 : 0;
+  if (g_cb_ready) checkerboard_invalidate(&g_cb);
+  g_redraw = 1;
+  runtime_request_frame(0.0);
+  return g_checkerboard;
+}
+
+EMSCRIPTEN_KEEPALIVE int mandelbrot_get_checkerboard(void) {
+  return g_checkerboard;
+}
+
+// 1 (the default) cycles the palette; 0 freezes it where it is, so a
+// finished view stops redrawing.
+EMSCRIPTEN_KEEPALIVE int mandelbrot_set_palette_animation(int enabled) {
+  g_animate = enabled ? 1 : 0;
+  runtime_request_frame(0.0);
+  return g_animate;
+}
+
+EMSCRIPTEN_KEEPALIVE int mandelbrot_get_palette_animation(void) {
+  return g_animate;
+}
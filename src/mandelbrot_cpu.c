@@ -0,0 +1,240 @@
+#include <math.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#if defined(__wasm_simd128__) && !defined(MANDELBROT_NO_SIMD)
+#include <wasm_simd128.h>
+#define MANDELBROT_SIMD 1
+#elif defined(__SSE2__) && !defined(MANDELBROT_NO_SIMD)
+#include <emmintrin.h>
+#define MANDELBROT_SIMD 1
+#else
+#define MANDELBROT_SIMD 0
+#endif
+
+#include "mandelbrot_cpu.h"
+#include "workpool.h"
+
+// Square tiles handed out to the pool one at a time, so costly tiles near
+// the set boundary balance across threads.
+#define TILE 32
+
+typedef struct {
+  float *out;
+  int width, height;
+  int tiles_x;
+  MandelbrotView view;
+  int use_simd;
+  uint64_t *tile_iters;
+} RenderJob;
+
+int mandelbrot_cpu_simd_available(void) {
+  return MANDELBROT_SIMD;
+}
+
+// Smooth count from the escape iteration and |z|^2, as in the shader.
+static float smooth_count(int i, float r2) {
+  float nu = (float)i - log2f(log2f(r2)) + 4.0f;
+  return fmaxf(nu, 1e-3f) / 150.0f;
+}
+
+// Real part of c at column x; the shader sees the same pixel-center v_pos.
+static float column_cx(const MandelbrotView *v, int width, int x) {
+  float u = (float)(2 * x + 1) / (float)width - 1.0f;
+  return v->center_x + (u * v->aspect) * v->scale;
+}
+
+static float row_cy(const MandelbrotView *v, int height, int y) {
+  float u = (float)(2 * y + 1) / (float)height - 1.0f;
+  return v->center_y + u * v->scale;
+}
+
+// Closed-form main cardioid and period-2 bulb membership.
+static int interior(float cx, float cy) {
+  float x = cx - 0.25f;
+  float y2 = cy * cy;
+  float q = x * x + y2;
+  if (q * (q + x) < 0.25f * y2 - MANDELBROT_INTERIOR_MARGIN) return 1;
+  float b = cx + 1.0f;
+  return b * b + y2 < 0.0625f - MANDELBROT_INTERIOR_MARGIN;
+}
+
+// Iterations a pixel took: the escape (or cycle) step + 1, or max_iter.
+static uint64_t escape_scalar(const MandelbrotView *v, float cx, float cy, float *m) {
+  *m = 0.0f;
+  if (v->interior_checks && interior(cx, cy)) return 0;
+  float zx = 0.0f, zy = 0.0f;
+  float saved_x = 0.0f, saved_y = 0.0f;
+  int lam = 0, power = 1;
+  for (int i = 0; i < v->max_iter; ++i) {
+    float nx = (zx * zx - zy * zy) + cx;
+    float ny = (2.0f * zx) * zy + cy;
+    zx = nx;
+    zy = ny;
+    float r2 = zx * zx + zy * zy;
+    if (r2 > 4.0f) {
+      *m = smooth_count(i, r2);
+      return (uint64_t)i + 1;
+    }
+    if (fabsf(zx - saved_x) < v->period_eps && fabsf(zy - saved_y) < v->period_eps) return (uint64_t)i + 1;
+    if (++lam == power) {
+      saved_x = zx;
+      saved_y = zy;
+      power *= 2;
+      lam = 0;
+    }
+  }
+  return (uint64_t)v->max_iter;
+}
+
+#if MANDELBROT_SIMD
+#if defined(__wasm_simd128__)
+typedef v128_t vf;
+#define vf_splat wasm_f32x4_splat
+#define vf_load wasm_v128_load
+#define vf_store wasm_v128_store
+#define vf_add wasm_f32x4_add
+#define vf_sub wasm_f32x4_sub
+#define vf_mul wasm_f32x4_mul
+#define vf_gt wasm_f32x4_gt
+#define vf_lt wasm_f32x4_lt
+#define vf_abs wasm_f32x4_abs
+#define vf_or wasm_v128_or
+#define vf_and wasm_v128_and
+#define vf_andnot wasm_v128_andnot
+#define vf_any wasm_v128_any_true
+static inline vf vf_select(vf mask, vf a, vf b) {
+  return wasm_v128_bitselect(a, b, mask);
+}
+#else
+typedef __m128 vf;
+#define vf_splat _mm_set1_ps
+#define vf_load _mm_loadu_ps
+#define vf_store _mm_storeu_ps
+#define vf_add _mm_add_ps
+#define vf_sub _mm_sub_ps
+#define vf_mul _mm_mul_ps
+#define vf_gt _mm_cmpgt_ps
+#define vf_lt _mm_cmplt_ps
+#define vf_abs(a) _mm_andnot_ps(_mm_set1_ps(-0.0f), a)
+#define vf_or _mm_or_ps
+#define vf_and _mm_and_ps
+// Operand order as in wasm_v128_andnot: a & ~b.
+#define vf_andnot(a, b) _mm_andnot_ps(b, a)
+#define vf_any(m) (_mm_movemask_ps(m) != 0)
+static inline vf vf_select(vf mask, vf a, vf b) {
+  return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b));
+}
+#endif
+
+// Four pixels of one row at once. A lane stops updating once it escapes
+// or cycles, with its step (and |z|^2 on escape) captured; the loop exits
+// when no lane is left. Brent's schedule is the same for every lane.
+static uint64_t escape_simd(const MandelbrotView *v, const float cx[4], float cy, float m[4]) {
+  const vf vcx = vf_load(cx);
+  const vf vcy = vf_splat(cy);
+  const vf four = vf_splat(4.0f);
+  const vf two = vf_splat(2.0f);
+  const vf eps = vf_splat(v->period_eps);
+  vf zx = vf_splat(0.0f), zy = zx;
+  vf saved_x = zx, saved_y = zx;
+  vf done_i = vf_splat(-1.0f), esc_r2 = zx;
+  vf active = vf_gt(four, zx);
+  if (v->interior_checks) {
+    int lanes = 0;
+    float inside[4];
+    for (int k = 0; k < 4; ++k) {
+      inside[k] = interior(cx[k], cy) ? 1.0f : 0.0f;
+      lanes += inside[k] != 0.0f;
+    }
+    if (lanes == 4) {
+      m[0] = m[1] = m[2] = m[3] = 0.0f;
+      return 0;
+    }
+    active = vf_andnot(active, vf_gt(vf_load(inside), zx));
+  }
+  int lam = 0, power = 1;
+  for (int i = 0; i < v->max_iter && vf_any(active); ++i) {
+    vf nx = vf_add(vf_sub(vf_mul(zx, zx), vf_mul(zy, zy)), vcx);
+    vf ny = vf_add(vf_mul(vf_mul(two, zx), zy), vcy);
+    zx = vf_select(active, nx, zx);
+    zy = vf_select(active, ny, zy);
+    vf r2 = vf_add(vf_mul(nx, nx), vf_mul(ny, ny));
+    vf escaped = vf_and(active, vf_gt(r2, four));
+    vf cycled = vf_and(vf_lt(vf_abs(vf_sub(nx, saved_x)), eps), vf_lt(vf_abs(vf_sub(ny, saved_y)), eps));
+    vf finished = vf_or(escaped, vf_and(active, cycled));
+    done_i = vf_select(finished, vf_splat((float)i), done_i);
+    esc_r2 = vf_select(escaped, r2, esc_r2);
+    active = vf_andnot(active, finished);
+    if (++lam == power) {
+      saved_x = zx;
+      saved_y = zy;
+      power *= 2;
+      lam = 0;
+    }
+  }
+  float lane_i[4], lane_r2[4];
+  vf_store(lane_i, done_i);
+  vf_store(lane_r2, esc_r2);
+  uint64_t iters = 0;
+  for (int k = 0; k < 4; ++k) {
+    m[k] = lane_r2[k] > 4.0f ? smooth_count((int)lane_i[k], lane_r2[k]) : 0.0f;
+    if (lane_i[k] >= 0.0f) {
+      iters += (uint64_t)lane_i[k] + 1;
+    } else if (!v->interior_checks || !interior(cx[k], cy)) {
+      iters += (uint64_t)v->max_iter;
+    }
+  }
+  return iters;
+}
+#endif
+
+static void render_tiles(void *ctx, int begin, int end) {
+  RenderJob *job = ctx;
+  const MandelbrotView *v = &job->view;
+  for (int t = begin; t < end; ++t) {
+    int x0 = (t % job->tiles_x) * TILE;
+    int y0 = (t / job->tiles_x) * TILE;
+    int x1 = x0 + TILE < job->width ? x0 + TILE : job->width;
+    int y1 = y0 + TILE < job->height ? y0 + TILE : job->height;
+    uint64_t iters = 0;
+    for (int y = y0; y < y1; ++y) {
+      float cy = row_cy(v, job->height, y);
+      float *row = job->out + (size_t)y * job->width;
+      int x = x0;
+#if MANDELBROT_SIMD
+      if (job->use_simd) {
+        for (; x + 4 <= x1; x += 4) {
+          float cx[4] = {column_cx(v, job->width, x), column_cx(v, job->width, x + 1),
+                         column_cx(v, job->width, x + 2), column_cx(v, job->width, x + 3)};
+          iters += escape_simd(v, cx, cy, row + x);
+        }
+      }
+#endif
+      for (; x < x1; ++x) iters += escape_scalar(v, column_cx(v, job->width, x), cy, row + x);
+    }
+    if (job->tile_iters) job->tile_iters[t] = iters;
+  }
+}
+
+uint64_t mandelbrot_cpu_render(float *out, int width, int height, const MandelbrotView *view, int use_simd) {
+  if (width < 1 || height < 1) return 0;
+  RenderJob job;
+  job.out = out;
+  job.width = width;
+  job.height = height;
+  job.tiles_x = (width + TILE - 1) / TILE;
+  job.view = *view;
+  job.use_simd = use_simd && MANDELBROT_SIMD;
+  int tiles = job.tiles_x * ((height + TILE - 1) / TILE);
+  // Per-tile counts avoid contended atomics; without them only the image
+  // is produced.
+  job.tile_iters = calloc((size_t)tiles, sizeof *job.tile_iters);
+  workpool_run(render_tiles, &job, tiles, 1);
+  uint64_t total = 0;
+  if (job.tile_iters) {
+    for (int t = 0; t < tiles; ++t) total += job.tile_iters[t];
+    free(job.tile_iters);
+  }
+  return total;
+}
@@ -0,0 +1,47 @@
+#ifndef MANDELBROT_CPU_H
+#define MANDELBROT_CPU_H
+
+#include <stdint.h>
+
+// GL-free escape-time renderer: the CPU fallback for the Mandelbrot demo
+// and a reference for its float shader. It builds into the wasm demo and
+// natively (see `make bench-mandelbrot`).
+
+// Interior fast paths shared with the shaders. Points inside the main
+// cardioid or the period-2 bulb by more than MANDELBROT_INTERIOR_MARGIN
+// skip iteration; the margin keeps rounding in c from rejecting points
+// that escape. An orbit that returns within period_eps of the point Brent's
+// cycle search saved is taken as periodic (interior). period_eps is a
+// fraction of the pixel size, so slow escapes near the boundary are not
+// mistaken for cycles.
+#define MANDELBROT_INTERIOR_MARGIN 1e-6f
+#define MANDELBROT_PERIOD_EPS_PIXELS 0.001
+
+// View parameters as the float shader receives them: pixel (x, y), with
+// row 0 at the bottom, maps to c = center + (u * aspect, v) * scale for
+// (u, v) the pixel center in [-1, 1]^2. period_eps <= 0 disables cycle
+// detection; interior_checks = 0 disables the cardioid and bulb tests.
+typedef struct {
+  float center_x, center_y;
+  float scale;
+  float aspect;
+  int max_iter;
+  float period_eps;
+  int interior_checks;
+} MandelbrotView;
+
+static inline float mandelbrot_period_eps(double pixel) {
+  return (float)(pixel * MANDELBROT_PERIOD_EPS_PIXELS);
+}
+
+// 1 when a SIMD kernel (WASM SIMD128 or SSE2) was compiled in.
+int mandelbrot_cpu_simd_available(void);
+
+// Writes width * height smooth counts m to `out`, row-major from the
+// bottom row, matching the float shader: m = max(nu, 1e-3) / 150 for
+// escaping points, 0 for points that never escaped or were found
+// interior. Tiles run on the shared worker pool. Returns the iterations
+// performed over all pixels.
+uint64_t mandelbrot_cpu_render(float *out, int width, int height, const MandelbrotView *view, int use_simd);
+
+#endif /* MANDELBROT_CPU_H */
@@ -1,10 +1,12 @@
 #include <GLES3/gl3.h>
+#include <emscripten.h>
 #include <math.h>
 #include <stddef.h>
 #ifdef DEBUG
 #include <stdio.h>
 #endif
 
+#include "checkerboard.h"
 #include "demo_app.h"
 
 static GLuint g_program = 0;
@@ -12,10 +14,19 @@ static GLuint g_vao = 0;
 static GLuint g_vbo = 0;
 static GLint g_time_loc = -1;
 static GLint g_aspect_loc = -1;
+static GLint g_cb_parity_loc = -1;
+static GLint g_cb_width_loc = -1;
 static int g_width = 0;
 static int g_height = 0;
 static int g_active = 0;
 
+// The plasma changes slowly from frame to frame, so by default only half
+// the pixels are shaded each frame (see checkerboard.h). g_cb_ready is 0
+// when the helper could not be set up; frames are then shaded in full.
+static Checkerboard g_cb;
+static int g_cb_ready = 0;
+static int g_checkerboard = 1;
+
 static const char *VERT_SRC =
     "#version 300 es\n"
     "layout(location=0) in vec2 a_pos;\n"
@@ -28,12 +39,14 @@ static const char *VERT_SRC =
 static const char *FRAG_SRC =
     "#version 300 es\n"
     "precision highp float;\n"
+    "precision highp int;\n"
     "in vec2 v_uv;\n"
     "uniform float u_time;\n"
     "uniform float u_aspect;\n"
     "out vec4 fragColor;\n"
+    CHECKERBOARD_GLSL
     "void main(){\n"
-    "  vec2 uv = v_uv * 2.0 - 1.0;\n"
+    "  vec2 uv = checkerboard_pos(v_uv * 2.0 - 1.0);\n"
     "  uv.x *= u_aspect;\n"
     "  float t = u_time * 0.4;\n"
     "  mat2 rot = mat2(cos(t * 0.7), -sin(t * 0.7), sin(t * 0.7), cos(t * 0.7));\n"
@@ -98,6 +111,9 @@ void demo_app_init(int width, int height) {
   g_program = link_program(vs, fs);
   g_time_loc = glGetUniformLocation(g_program, "u_time");
   g_aspect_loc = glGetUniformLocation(g_program, "u_aspect");
+  g_cb_parity_loc = glGetUniformLocation(g_program, "u_cb_parity");
+  g_cb_width_loc = glGetUniformLocation(g_program, "u_cb_width");
+  g_cb_ready = checkerboard_init(&g_cb);
 
   const GLfloat verts[] = {
       -1.0f, -1.0f,
@@ -121,26 +137,44 @@ void demo_app_init(int width, int height) {
 void demo_app_resize(int width, int height) {
   g_width = width;
   g_height = height;
+  if (g_cb_ready && !checkerboard_resize(&g_cb, width, height)) {
+    checkerboard_shutdown(&g_cb);
+    g_cb_ready = 0;
+  }
   glViewport(0, 0, g_width, g_height);
 }
 
-void demo_app_frame(double time_sec, double dt_sec) {
+int demo_app_frame(double time_sec, double dt_sec) {
   (void)dt_sec;
-  if (!g_active) return;
+  if (!g_active) return 0;
 
   float t = (float)time_sec;
   float aspect = (g_height > 0) ? ((float)g_width / (float)g_height) : 1.0f;
 
+  int checker = g_checkerboard && g_cb_ready;
+
   glDisable(GL_DEPTH_TEST);
   glClearColor(0.02f, 0.03f, 0.05f, 1.0f);
-  glClear(GL_COLOR_BUFFER_BIT);
+  if (checker) {
+    checkerboard_begin(&g_cb);
+  } else {
+    glViewport(0, 0, g_width, g_height);
+    glClear(GL_COLOR_BUFFER_BIT);
+  }
 
   glUseProgram(g_program);
   glUniform1f(g_time_loc, t);
   glUniform1f(g_aspect_loc, aspect);
+  if (checker) {
+    checkerboard_set_uniforms(&g_cb, g_cb_parity_loc, g_cb_width_loc);
+  } else if (g_cb_parity_loc >= 0) {
+    glUniform1i(g_cb_parity_loc, -1);
+  }
 
   glBindVertexArray(g_vao);
   glDrawArrays(GL_TRIANGLES, 0, 3);
+  if (checker) checkerboard_resolve(&g_cb, NULL);
+  return DEMO_FRAME_DRAWN | DEMO_FRAME_AGAIN;
 }
 
 void demo_app_set_active(int active) {
@@ -160,6 +194,10 @@ void demo_app_shutdown(void) {
     glDeleteProgram(g_program);
     g_program = 0;
   }
+  if (g_cb_ready) {
+    checkerboard_shutdown(&g_cb);
+    g_cb_ready = 0;
+  }
 }
 
 void demo_app_handle_key(int key, int pressed) {
@@ -170,3 +208,15 @@ void demo_app_handle_key(int key, int pressed) {
 void demo_app_update_mouse(float x, float y, int present) {
   (void)x; (void)y; (void)present;
 }
+
+// 1 (the default) shades half the pixels per frame and fills in the rest
+// from the previous frame; 0 shades every pixel.
+EMSCRIPTEN_KEEPALIVE int plasma_set_checkerboard(int enabled) {
+  g_checkerboard = enabled ? 1 : 0;
+  if (g_cb_ready) checkerboard_invalidate(&g_cb);
+  return g_checkerboard;
+}
+
+EMSCRIPTEN_KEEPALIVE int plasma_get_checkerboard(void) {
+  return g_checkerboard;
+}
@@ -1,19 +1,168 @@
+#include <GLES3/gl3.h>
 #include <emscripten.h>
 #include <emscripten/html5.h>
 #include <math.h>
+#include <stdarg.h>
+#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#ifdef RUNTIME_WORKER
+#include <emscripten/proxying.h>
+#include <pthread.h>
+#endif
 
 #include "demo_app.h"
 
+// Demos render at a scale of their canvas resolution (bounded per demo by
+// -DRUNTIME_MIN_SCALE / -DRUNTIME_MAX_SCALE, or the dispatch table in the
+// combined build), into an offscreen target that is upscaled onto the
+// canvas. Each surface is scaled by its own cost, the larger of the CPU
+// time of its frame hook and its latest GPU time (the two overlap), against
+// an equal share of the 60 Hz frame among the surfaces that are ticking.
+// The scale steps down while the smoothed cost is over that share and back
+// up after a long run of frames where the cost at the next step up would
+// still fit, waiting SCALE_SETTLE_FRAMES after every change.
+#ifndef RUNTIME_MIN_SCALE
+#define RUNTIME_MIN_SCALE 0.5
+#endif
+#ifndef RUNTIME_MAX_SCALE
+#define RUNTIME_MAX_SCALE 1.0
+#endif
+#define SCALE_STEP 0.125
+#define FRAME_BUDGET_MS (1000.0 / 60.0)
+#define SCALE_SETTLE_FRAMES 30
+#define SCALE_UP_FRAMES 120
+// Cost at the next scale is estimated from pixel count; stay this far
+// under the budget with it before stepping up.
+#define SCALE_UP_MARGIN 0.9
+#define MSAA_SAMPLES 4
+#define MAX_SURFACES 8
+
+// Frame telemetry: the last TELEMETRY_FRAMES drawn frames of each surface,
+// TELEMETRY_FIELDS floats each (see record_frame). GPU times come from
+// EXT_disjoint_timer_query_webgl2 with up to TIMER_QUERIES frames in flight
+// per surface, read back once available so the CPU never waits on them.
+#define TELEMETRY_FRAMES 256
+#define TELEMETRY_FIELDS 4
+#define TIMER_QUERIES 4
+#define TELEMETRY_JSON_SIZE 16384
+#ifndef GL_TIME_ELAPSED_EXT
+#define GL_TIME_ELAPSED_EXT 0x88BF
+#endif
+#ifndef GL_GPU_DISJOINT_EXT
+#define GL_GPU_DISJOINT_EXT 0x8FBB
+#endif
+
+// The combined build (-DRUNTIME_COMBINED) renders every demo with one
+// context on a detached canvas; each frame is blitted there and copied
+// onto the demo's own canvas.
+#define SHARED_CANVAS "!runtime-gl"
+
+// A demo and the canvas it shows on. Its offscreen target (with MSAA when
+// the demo wants it; canvases never have it, since they receive blits)
+// stands in for framebuffer 0 while the demo runs, so demos need no
+// changes. It outlives canvas resizes, so the last frame can be presented
+// again without asking the demo.
+typedef struct {
+  const DemoApp *app;
+  int active;
+  // The main loop ticks awake surfaces; a frame that does not ask for the
+  // next one (see DEMO_FRAME_* in demo_app.h) puts its surface to sleep
+  // until input, a resize or runtime_request_frame().
+  int awake;
+  // Whether the last frame asked for the next one, i.e. dt is a frame interval.
+  int ticking;
+  int present_pending;
+  double prev_time;
+  int canvas_w, canvas_h;
+  // Canvas pixels per CSS pixel (devicePixelRatio, as the loader measured it).
+  double pixel_ratio;
+  // Size the demo renders at.
+  int width, height;
+  double scale, min_scale, max_scale;
+  // Smoothed cost per frame, and the latest GPU time (-1 if none yet).
+  double frame_ms, gpu_ms;
+  int settle_frames, fast_frames;
+  GLuint fbo, color_rb;
+  GLuint resolve_fbo, resolve_rb;
+  int samples;
+  // Presented through the shared canvas rather than drawn on its own.
+  int copy;
+  // Telemetry ring, `frames` records written so far. Pending timer queries
+  // start at query_first; query_record is the ring entry each one measures
+  // (-1 for frames that drew nothing).
+  float telemetry[TELEMETRY_FRAMES * TELEMETRY_FIELDS];
+  unsigned frames;
+  int timed;
+  GLuint queries[TIMER_QUERIES];
+  int query_record[TIMER_QUERIES];
+  int query_first, queries_pending;
+} Surface;
+
 static EMSCRIPTEN_WEBGL_CONTEXT_HANDLE g_ctx = 0;
-static int g_active = 0;
-static double g_prev_time = 0.0;
-static int g_width = 0;
-static int g_height = 0;
-static float g_mouse_x = 0.0f;
-static float g_mouse_y = 0.0f;
-static int g_mouse_present = 0;
+static Surface g_surfaces[MAX_SURFACES];
+static int g_surface_count = 0;
+static int g_max_samples = 0;
+// Size of the shared canvas, grown to fit the largest surface.
+static int g_shared_w = 0;
+static int g_shared_h = 0;
+// Surfaces that asked for another frame last time round; they split the
+// frame budget between them.
+static int g_ticking_count = 0;
+// The main loop is paused while no surface is awake.
+static int g_sleeping = 0;
+static int g_wake_timer = 0;
+static double g_wake_at = 0.0;
+// Selector of the canvas the context was created on (single-demo builds).
+static char *g_selector = NULL;
+static int g_gpu_timer = 0;
+// Frame-time graph drawn over every canvas (runtime_set_telemetry_overlay).
+static int g_overlay = 0;
+static GLuint g_overlay_program = 0;
+static GLuint g_overlay_vao = 0;
+static GLuint g_overlay_tex = 0;
+static GLint g_overlay_first_loc = -1;
+static GLint g_overlay_count_loc = -1;
+static GLint g_overlay_lines_loc = -1;
+static GLint g_overlay_range_loc = -1;
+
+// Worker builds (-DRUNTIME_WORKER, linked with PROXY_TO_PTHREAD and
+// OFFSCREENCANVAS_SUPPORT) run main() and the frame loop on a pthread that
+// owns the canvases, transferred as OffscreenCanvases (in the combined
+// build, over the port from runtime_open_port). The page calls in on the
+// browser thread; those calls are forwarded to the render thread, input and
+// setters asynchronously so a busy page never waits for a frame.
+typedef enum { CALL_SET_ACTIVE, CALL_RESIZE, CALL_PIXEL_RATIO, CALL_MOUSE, CALL_SCALE_BOUNDS, CALL_OVERLAY } CallKind;
+
+#ifdef RUNTIME_WORKER
+static pthread_t g_render_thread;
+
+typedef struct {
+  CallKind kind;
+  int id;
+  double a, b;
+  int c;
+} RuntimeCall;
+#endif
+
+#ifndef RUNTIME_COMBINED
+#ifdef RUNTIME_NO_MSAA
+#define RUNTIME_MSAA 0
+#else
+#define RUNTIME_MSAA 1
+#endif
+#ifdef RUNTIME_NO_GPU_TIMER
+#define RUNTIME_GPU_TIMER 0
+#else
+#define RUNTIME_GPU_TIMER 1
+#endif
+const DemoApp demo_apps[] = {
+    {"demo", demo_app_init, demo_app_resize, demo_app_frame, demo_app_set_active, demo_app_handle_key,
+     demo_app_update_mouse, demo_app_shutdown, RUNTIME_MIN_SCALE, RUNTIME_MAX_SCALE, RUNTIME_MSAA,
+     RUNTIME_GPU_TIMER},
+};
+const int demo_app_count = 1;
+#endif
 
 EM_JS(char *, runtime_acquire_selector, (), {
   var selector = Module['__canvasSelector'] || '#canvas';
@@ -23,15 +172,452 @@ EM_JS(char *, runtime_acquire_selector, (), {
   return ptr;
 });
 
+// A worker has no document; an OffscreenCanvas serves there.
+EM_JS(void, runtime_create_shared_canvas, (const char *selector), {
+  specialHTMLTargets[UTF8ToString(selector)] =
+      typeof document != 'undefined' ? document.createElement('canvas') : new OffscreenCanvas(1, 1);
+});
+
+EM_JS(void, runtime_size_shared_canvas, (int width, int height), {
+  GLctx.canvas.width = width;
+  GLctx.canvas.height = height;
+});
+
+// Takes the canvas the loader left in Module.__surfaceCanvas for surface `id`.
+EM_JS(int, runtime_attach_canvas, (int id), {
+  var canvas = Module['__surfaceCanvas'];
+  Module['__surfaceCanvas'] = null;
+  var ctx = canvas && canvas.getContext('2d', {alpha: false});
+  if (!ctx) return 0;
+  (Module.__surfaces = Module.__surfaces || [])[id] = ctx;
+  return 1;
+});
+
+// Sizes surface `id`'s own canvas, which the page cannot do once it has
+// been transferred to the render thread.
+EM_JS(void, runtime_size_surface_canvas, (int id, int width, int height), {
+  var canvas = Module.__surfaces[id].canvas;
+  if (canvas.width != width) canvas.width = width;
+  if (canvas.height != height) canvas.height = height;
+});
+
+// Copies the top-left width x height of the shared canvas onto surface `id`.
+EM_JS(void, runtime_copy_to_canvas, (int id, int width, int height), {
+  Module.__surfaces[id].drawImage(GLctx.canvas, 0, 0, width, height, 0, 0, width, height);
+});
+
 static void ensure_context_current(void) {
   if (g_ctx) {
     emscripten_webgl_make_context_current(g_ctx);
   }
 }
 
+// Routes bindFramebuffer(null) to a surface's offscreen framebuffer (or
+// back to the canvas for fbo 0).
+EM_JS(void, runtime_redirect_default_fbo, (int fbo), {
+  var gl = GLctx;
+  if (!gl.__runtimeBind) {
+    var bind = gl.bindFramebuffer;
+    gl.__runtimeBind = bind;
+    gl.bindFramebuffer = function(target, framebuffer) {
+      bind.call(gl, target, framebuffer || gl.__runtimeDefaultFbo || null);
+    };
+  }
+  gl.__runtimeDefaultFbo = fbo ? GL.framebuffers[fbo] : null;
+});
+
+static Surface *surface_at(int id) {
+  return (id >= 0 && id < g_surface_count) ? &g_surfaces[id] : NULL;
+}
+
+// Points framebuffer 0 at the surface's target for its demo's calls.
+// The surface whose demo hooks run; see runtime_pixel_ratio.
+static Surface *g_bound = NULL;
+
+static void bind_surface(Surface *s) {
+  g_bound = s;
+  runtime_redirect_default_fbo((int)s->fbo);
+  glBindFramebuffer(GL_FRAMEBUFFER, 0);
+  glViewport(0, 0, s->width, s->height);
+  glActiveTexture(GL_TEXTURE0);
+}
+
+static void wake(Surface *s) {
+  if (!s->awake) {
+    s->awake = 1;
+    // The first interval after a pause is not a frame time.
+    s->prev_time = emscripten_get_now() * 0.001;
+    s->ticking = 0;
+  }
+  if (g_sleeping) {
+    g_sleeping = 0;
+    emscripten_resume_main_loop();
+  }
+}
+
+static void wake_active(void) {
+  for (int i = 0; i < g_surface_count; ++i) {
+    if (g_surfaces[i].active) wake(&g_surfaces[i]);
+  }
+}
+
+static void wake_timer(void *user_data) {
+  (void)user_data;
+  g_wake_timer = 0;
+  wake_active();
+}
+
+static void delete_offscreen(Surface *s) {
+  if (!s->fbo) return;
+  runtime_redirect_default_fbo(0);
+  glDeleteFramebuffers(1, &s->fbo);
+  glDeleteRenderbuffers(1, &s->color_rb);
+  if (s->resolve_fbo) glDeleteFramebuffers(1, &s->resolve_fbo);
+  if (s->resolve_rb) glDeleteRenderbuffers(1, &s->resolve_rb);
+  s->fbo = s->color_rb = s->resolve_fbo = s->resolve_rb = 0;
+}
+
+static GLuint make_framebuffer(GLuint *rb, int samples, int width, int height) {
+  GLuint fbo = 0;
+  glGenRenderbuffers(1, rb);
+  glBindRenderbuffer(GL_RENDERBUFFER, *rb);
+  glRenderbufferStorageMultisample(GL_RENDERBUFFER, samples, GL_RGBA8, width, height);
+  glGenFramebuffers(1, &fbo);
+  glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+  glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, *rb);
+  return fbo;
+}
+
+// Sizes the render target from the canvas and the scale; tells the demo
+// when its size changed. The canvas was cleared, so the frame is presented
+// again.
+static void apply_render_size(Surface *s) {
+  int width = (int)lround(s->canvas_w * s->scale);
+  int height = (int)lround(s->canvas_h * s->scale);
+  if (width < 1) width = 1;
+  if (height < 1) height = 1;
+  if (!s->fbo || width != s->width || height != s->height) {
+    delete_offscreen(s);
+    s->fbo = make_framebuffer(&s->color_rb, s->samples, width, height);
+    if (s->samples > 0) s->resolve_fbo = make_framebuffer(&s->resolve_rb, 0, width, height);
+    runtime_redirect_default_fbo((int)s->fbo);
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
+    glClear(GL_COLOR_BUFFER_BIT);
+  }
+  if (width != s->width || height != s->height) {
+    s->width = width;
+    s->height = height;
+    bind_surface(s);
+    s->app->resize(width, height);
+  }
+  s->present_pending = 1;
+  wake(s);
+}
+
+// Appends a drawn frame to the surface's telemetry: the frame interval in ms
+// (-1 when the surface had not been ticking), the CPU time of the demo's
+// frame hook in ms, its GPU time in ms (-1 until the timer query comes back,
+// or when there is none) and the render scale. Returns the ring entry.
+static int record_frame(Surface *s, double interval_ms, double cpu_ms) {
+  int index = (int)(s->frames % TELEMETRY_FRAMES);
+  float *record = &s->telemetry[index * TELEMETRY_FIELDS];
+  record[0] = (float)interval_ms;
+  record[1] = (float)cpu_ms;
+  record[2] = -1.0f;
+  record[3] = (float)s->scale;
+  s->frames++;
+  return index;
+}
+
+// Starts timing the demo's frame on the GPU if a query is free.
+static int begin_gpu_timer(Surface *s) {
+  if (!s->timed || s->queries_pending == TIMER_QUERIES) return 0;
+  if (!s->queries[0]) glGenQueries(TIMER_QUERIES, s->queries);
+  glBeginQuery(GL_TIME_ELAPSED_EXT, s->queries[(s->query_first + s->queries_pending) % TIMER_QUERIES]);
+  return 1;
+}
+
+static void end_gpu_timer(Surface *s, int record) {
+  glEndQuery(GL_TIME_ELAPSED_EXT);
+  s->query_record[(s->query_first + s->queries_pending) % TIMER_QUERIES] = record;
+  s->queries_pending++;
+}
+
+// Files the results of finished queries, oldest first, and stops at the
+// first one still running. A disjoint event invalidates every pending one.
+static void poll_gpu_timer(Surface *s) {
+  if (!s->queries_pending) return;
+  GLint disjoint = 0;
+  glGetIntegerv(GL_GPU_DISJOINT_EXT, &disjoint);
+  while (s->queries_pending > 0) {
+    GLuint query = s->queries[s->query_first];
+    int record = s->query_record[s->query_first];
+    if (!disjoint) {
+      GLuint available = 0;
+      glGetQueryObjectuiv(query, GL_QUERY_RESULT_AVAILABLE, &available);
+      if (!available) break;
+      if (record >= 0) {
+        GLuint ns = 0;
+        glGetQueryObjectuiv(query, GL_QUERY_RESULT, &ns);
+        s->telemetry[record * TELEMETRY_FIELDS + 2] = (float)((double)ns * 1e-6);
+        s->gpu_ms = (double)ns * 1e-6;
+      }
+    }
+    s->query_first = (s->query_first + 1) % TIMER_QUERIES;
+    s->queries_pending--;
+  }
+}
+
+static int compare_floats(const void *a, const void *b) {
+  float x = *(const float *)a, y = *(const float *)b;
+  return (x > y) - (x < y);
+}
+
+// p50/p95/p99 (nearest rank) of one telemetry field over the recorded
+// frames, skipping unknown (-1) values. Returns how many were known.
+static int telemetry_percentiles(const Surface *s, int field, float out[3]) {
+  float values[TELEMETRY_FRAMES];
+  int total = s->frames < TELEMETRY_FRAMES ? (int)s->frames : TELEMETRY_FRAMES;
+  int count = 0;
+  for (int i = 0; i < total; ++i) {
+    float v = s->telemetry[i * TELEMETRY_FIELDS + field];
+    if (v >= 0.0f) values[count++] = v;
+  }
+  static const double ranks[3] = {0.50, 0.95, 0.99};
+  if (!count) {
+    out[0] = out[1] = out[2] = -1.0f;
+    return 0;
+  }
+  qsort(values, count, sizeof values[0], compare_floats);
+  for (int i = 0; i < 3; ++i) {
+    int rank = (int)ceil(ranks[i] * count);
+    out[i] = values[rank > 0 ? rank - 1 : 0];
+  }
+  return count;
+}
+
+// The overlay graphs the telemetry ring, newest frame on the right: frame
+// intervals in gray, CPU times in blue over them, GPU times as orange
+// marks, the 60 Hz budget in white and the p50/p95/p99 frame intervals in
+// yellow, orange and red.
+static const char *OVERLAY_VERT_SRC =
+    "#version 300 es\n"
+    "out vec2 v_uv;\n"
+    "void main(){\n"
+    "  vec2 p = vec2(float((gl_VertexID & 1) << 2), float((gl_VertexID & 2) << 1)) - 1.0;\n"
+    "  v_uv = p * 0.5 + 0.5;\n"
+    "  gl_Position = vec4(p, 0.0, 1.0);\n"
+    "}\n";
+
+static const char *OVERLAY_FRAG_SRC =
+    "#version 300 es\n"
+    "precision highp float;\n"
+    "precision highp int;\n"
+    "in vec2 v_uv;\n"
+    "uniform highp sampler2D u_frames;\n"
+    "uniform int u_first;\n"
+    "uniform int u_count;\n"
+    "uniform vec3 u_lines;\n"
+    "uniform float u_range;\n"
+    "out vec4 fragColor;\n"
+    "bool on_line(float ms, float at, float px){ return at >= 0.0 && abs(ms - at) < px; }\n"
+    "void main(){\n"
+    "  int n = textureSize(u_frames, 0).x;\n"
+    "  int column = int(v_uv.x * float(n)) - (n - u_count);\n"
+    "  float ms = v_uv.y * u_range;\n"
+    "  float px = abs(dFdy(ms));\n"
+    "  vec4 col = vec4(0.0, 0.0, 0.0, 0.6);\n"
+    "  if (column >= 0) {\n"
+    "    vec4 f = texelFetch(u_frames, ivec2((u_first + column) % n, 0), 0);\n"
+    "    if (ms < f.x) col = vec4(0.45, 0.45, 0.5, 0.85);\n"
+    "    if (ms < f.y) col = vec4(0.25, 0.65, 1.0, 0.9);\n"
+    "    if (on_line(ms, f.z, px)) col = vec4(1.0, 0.55, 0.1, 1.0);\n"
+    "  }\n"
+    "  if (on_line(ms, 1000.0 / 60.0, px * 0.5)) col = vec4(1.0, 1.0, 1.0, 0.6);\n"
+    "  if (on_line(ms, u_lines.x, px * 0.5)) col = vec4(1.0, 0.9, 0.2, 1.0);\n"
+    "  if (on_line(ms, u_lines.y, px * 0.5)) col = vec4(1.0, 0.5, 0.1, 1.0);\n"
+    "  if (on_line(ms, u_lines.z, px * 0.5)) col = vec4(1.0, 0.15, 0.1, 1.0);\n"
+    "  fragColor = col;\n"
+    "}\n";
+
+static GLuint compile_shader(GLenum type, const char *src) {
+  GLuint shader = glCreateShader(type);
+  glShaderSource(shader, 1, &src, NULL);
+  glCompileShader(shader);
+  GLint ok = 0;
+  glGetShaderiv(shader, GL_COMPILE_STATUS, &ok);
+  if (!ok) {
+    glDeleteShader(shader);
+    return 0;
+  }
+  return shader;
+}
+
+static int create_overlay(void) {
+  GLuint vs = compile_shader(GL_VERTEX_SHADER, OVERLAY_VERT_SRC);
+  GLuint fs = compile_shader(GL_FRAGMENT_SHADER, OVERLAY_FRAG_SRC);
+  GLuint program = glCreateProgram();
+  glAttachShader(program, vs);
+  glAttachShader(program, fs);
+  glLinkProgram(program);
+  glDeleteShader(vs);
+  glDeleteShader(fs);
+  GLint ok = 0;
+  glGetProgramiv(program, GL_LINK_STATUS, &ok);
+  if (!ok) {
+    glDeleteProgram(program);
+    return 0;
+  }
+  g_overlay_program = program;
+  g_overlay_first_loc = glGetUniformLocation(program, "u_first");
+  g_overlay_count_loc = glGetUniformLocation(program, "u_count");
+  g_overlay_lines_loc = glGetUniformLocation(program, "u_lines");
+  g_overlay_range_loc = glGetUniformLocation(program, "u_range");
+  glGenVertexArrays(1, &g_overlay_vao);
+  glGenTextures(1, &g_overlay_tex);
+  glBindTexture(GL_TEXTURE_2D, g_overlay_tex);
+  glTexStorage2D(GL_TEXTURE_2D, 1, GL_RGBA32F, TELEMETRY_FRAMES, 1);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+  return 1;
+}
+
+// Draws the graph into the top-left corner of the surface's canvas, whose
+// bottom edge is at row y of framebuffer 0. Leaves blending off, as every
+// demo expects; the rest of the state it touches the demos set themselves.
+static void draw_overlay(const Surface *s, int y) {
+  if (!g_overlay_program && !create_overlay()) {
+    g_overlay = 0;
+    return;
+  }
+  int width = s->canvas_w * 2 / 5;
+  if (width > 512) width = 512;
+  if (width < 128) width = s->canvas_w < 128 ? s->canvas_w : 128;
+  int height = width / 3;
+  int margin = width / 32;
+  float lines[3];
+  telemetry_percentiles(s, 0, lines);
+  float range = lines[2] * 1.25f;
+  if (range < 2.0f * 1000.0f / 60.0f) range = 2.0f * 1000.0f / 60.0f;
+  if (range > 100.0f) range = 100.0f;
+  glActiveTexture(GL_TEXTURE0);
+  glBindTexture(GL_TEXTURE_2D, g_overlay_tex);
+  glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, TELEMETRY_FRAMES, 1, GL_RGBA, GL_FLOAT, s->telemetry);
+  glViewport(margin, y + s->canvas_h - height - margin, width, height);
+  glEnable(GL_BLEND);
+  glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+  glUseProgram(g_overlay_program);
+  glUniform1i(g_overlay_first_loc, s->frames < TELEMETRY_FRAMES ? 0 : (int)(s->frames % TELEMETRY_FRAMES));
+  glUniform1i(g_overlay_count_loc, s->frames < TELEMETRY_FRAMES ? (int)s->frames : TELEMETRY_FRAMES);
+  glUniform3f(g_overlay_lines_loc, lines[0], lines[1], lines[2]);
+  glUniform1f(g_overlay_range_loc, range);
+  glBindVertexArray(g_overlay_vao);
+  glDrawArrays(GL_TRIANGLES, 0, 3);
+  glBindVertexArray(0);
+  glDisable(GL_BLEND);
+}
+
+// Resolves MSAA and upscales the offscreen target onto the canvas, through
+// the top-left corner of the shared canvas for copied surfaces.
+static void present(Surface *s) {
+  s->present_pending = 0;
+  if (!s->fbo) return;
+  GLuint src = s->fbo;
+  if (s->resolve_fbo) {
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, s->fbo);
+    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, s->resolve_fbo);
+    glBlitFramebuffer(0, 0, s->width, s->height, 0, 0, s->width, s->height, GL_COLOR_BUFFER_BIT, GL_NEAREST);
+    src = s->resolve_fbo;
+  }
+  int y = 0;
+  if (s->copy) {
+    if (s->canvas_w > g_shared_w || s->canvas_h > g_shared_h) {
+      if (s->canvas_w > g_shared_w) g_shared_w = s->canvas_w;
+      if (s->canvas_h > g_shared_h) g_shared_h = s->canvas_h;
+      runtime_size_shared_canvas(g_shared_w, g_shared_h);
+    }
+    y = g_shared_h - s->canvas_h;
+  }
+  runtime_redirect_default_fbo(0);
+  glBindFramebuffer(GL_READ_FRAMEBUFFER, src);
+  glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
+  glBlitFramebuffer(0, 0, s->width, s->height, 0, y, s->canvas_w, y + s->canvas_h, GL_COLOR_BUFFER_BIT,
+                    (s->width == s->canvas_w && s->height == s->canvas_h) ? GL_NEAREST : GL_LINEAR);
+  if (g_overlay) draw_overlay(s, y);
+  if (s->copy) runtime_copy_to_canvas((int)(s - g_surfaces), s->canvas_w, s->canvas_h);
+  runtime_redirect_default_fbo((int)s->fbo);
+  glBindFramebuffer(GL_FRAMEBUFFER, 0);
+}
+
+// Steps the scale from the surface's own frame cost; the loop interval is
+// shared by every surface, so it cannot tell which one is slow.
+static void update_render_scale(Surface *s, double cpu_ms) {
+  if (s->min_scale >= s->max_scale) return;
+  double ms = s->gpu_ms > cpu_ms ? s->gpu_ms : cpu_ms;
+  s->frame_ms = s->frame_ms > 0.0 ? s->frame_ms + 0.1 * (ms - s->frame_ms) : ms;
+  if (s->settle_frames > 0) {
+    s->settle_frames--;
+    return;
+  }
+  double budget = FRAME_BUDGET_MS / (g_ticking_count > 1 ? g_ticking_count : 1);
+  double scale = s->scale;
+  double up = (scale + SCALE_STEP) / scale;
+  if (s->frame_ms > budget) {
+    scale -= SCALE_STEP;
+    s->fast_frames = 0;
+  } else if (s->frame_ms * up * up < budget * SCALE_UP_MARGIN) {
+    if (++s->fast_frames >= SCALE_UP_FRAMES) {
+      scale += SCALE_STEP;
+      s->fast_frames = 0;
+    }
+  } else {
+    s->fast_frames = 0;
+  }
+  if (scale < s->min_scale) scale = s->min_scale;
+  if (scale > s->max_scale) scale = s->max_scale;
+  if (scale == s->scale) return;
+  s->scale = scale;
+  s->settle_frames = SCALE_SETTLE_FRAMES;
+  s->frame_ms = 0.0;
+  s->gpu_ms = -1.0;
+  apply_render_size(s);
+}
+
+// Creates the surface for `app` on a width x height canvas and starts the
+// demo, inactive. Returns its id, or -1.
+static int open_surface(const DemoApp *app, int width, int height, int copy) {
+  if (g_surface_count >= MAX_SURFACES) return -1;
+  int id = g_surface_count;
+  if (copy && !runtime_attach_canvas(id)) return -1;
+  Surface *s = &g_surfaces[g_surface_count++];
+  memset(s, 0, sizeof *s);
+  s->app = app;
+  s->copy = copy;
+  s->canvas_w = width > 0 ? width : 1;
+  s->canvas_h = height > 0 ? height : 1;
+  s->min_scale = app->min_scale;
+  s->max_scale = app->max_scale;
+  s->scale = app->max_scale;
+  s->pixel_ratio = 1.0;
+  s->gpu_ms = -1.0;
+  s->samples = app->msaa ? (g_max_samples < MSAA_SAMPLES ? g_max_samples : MSAA_SAMPLES) : 0;
+  s->timed = g_gpu_timer && app->gpu_timer;
+  // The demo starts at the size apply_render_size settles on, so its
+  // first resize is a no-op.
+  s->width = (int)lround(s->canvas_w * s->scale);
+  s->height = (int)lround(s->canvas_h * s->scale);
+  if (s->width < 1) s->width = 1;
+  if (s->height < 1) s->height = 1;
+  apply_render_size(s);
+  bind_surface(s);
+  app->init(s->width, s->height);
+  app->set_active(0);
+  return id;
+}
+
 static EM_BOOL handle_key_event(int type, const EmscriptenKeyboardEvent *ev, void *userData) {
   (void)userData;
-  if (!g_active) return EM_FALSE;
   int pressed = (type == EMSCRIPTEN_EVENT_KEYDOWN) ? 1 : 0;
   const char *code = ev->code;
   int key = -1;
@@ -41,49 +627,535 @@ static EM_BOOL handle_key_event(int type, const EmscriptenKeyboardEvent *ev, voi
   else if (!strcmp(code, "ArrowDown")) key = 3;
   else if (!strcmp(code, "KeyZ")) key = 4;
   else if (!strcmp(code, "KeyX")) key = 5;
-  if (key >= 0) {
-    demo_app_handle_key(key, pressed);
-    return EM_TRUE;
+  else if (!strcmp(code, "KeyC")) key = 6;
+  if (key < 0) return EM_FALSE;
+  EM_BOOL handled = EM_FALSE;
+  for (int i = 0; i < g_surface_count; ++i) {
+    Surface *s = &g_surfaces[i];
+    if (!s->active) continue;
+    ensure_context_current();
+    bind_surface(s);
+    s->app->handle_key(key, pressed);
+    wake(s);
+    handled = EM_TRUE;
   }
-  return EM_FALSE;
+  return handled;
 }
 
 static void frame(void) {
   ensure_context_current();
   double now = emscripten_get_now() * 0.001;
-  double dt = (g_prev_time > 0.0) ? (now - g_prev_time) : 0.0;
-  g_prev_time = now;
-  if (!g_active) return;
-  demo_app_frame(now, dt);
+  int awake = 0, ticking = 0;
+  for (int i = 0; i < g_surface_count; ++i) {
+    Surface *s = &g_surfaces[i];
+    if (!s->awake) continue;
+    double dt = (s->prev_time > 0.0) ? (now - s->prev_time) : 0.0;
+    s->prev_time = now;
+    if (!s->active) {
+      s->awake = 0;
+      continue;
+    }
+    bind_surface(s);
+    poll_gpu_timer(s);
+    int timed = begin_gpu_timer(s);
+    double start = emscripten_get_now();
+    int result = s->app->frame(now, dt);
+    double cpu_ms = emscripten_get_now() - start;
+    int record = -1;
+    if (result & DEMO_FRAME_DRAWN) record = record_frame(s, s->ticking ? dt * 1e3 : -1.0, cpu_ms);
+    if (timed) end_gpu_timer(s, record);
+    if (result & DEMO_FRAME_DRAWN) {
+      present(s);
+      if (s->ticking && !(result & DEMO_FRAME_REFINING)) update_render_scale(s, cpu_ms);
+    } else if (s->present_pending) {
+      present(s);
+    }
+    s->ticking = (result & DEMO_FRAME_AGAIN) != 0;
+    s->awake = s->ticking;
+    awake |= s->awake;
+    ticking += s->ticking;
+  }
+  g_ticking_count = ticking;
+  if (!awake && !g_sleeping) {
+    g_sleeping = 1;
+    emscripten_pause_main_loop();
+  }
+}
+
+void runtime_request_frame(double delay_ms) {
+  if (delay_ms <= 0.0) {
+    wake_active();
+    return;
+  }
+  double at = emscripten_get_now() + delay_ms;
+  if (g_wake_timer) {
+    if (g_wake_at <= at) return;
+    emscripten_clear_timeout(g_wake_timer);
+  }
+  g_wake_at = at;
+  g_wake_timer = emscripten_set_timeout(wake_timer, delay_ms, NULL);
+}
+
+#ifdef RUNTIME_WORKER
+void runtime_surface_set_active(int id, int active);
+void runtime_surface_resize(int id, int width, int height);
+void runtime_surface_set_pixel_ratio(int id, double ratio);
+void runtime_surface_update_mouse(int id, float x, float y, int present);
+void runtime_surface_set_scale_bounds(int id, double min_scale, double max_scale);
+void runtime_set_telemetry_overlay(int on);
+
+static void run_call(void *arg) {
+  RuntimeCall *call = arg;
+  switch (call->kind) {
+    case CALL_SET_ACTIVE: runtime_surface_set_active(call->id, call->c); break;
+    case CALL_RESIZE: runtime_surface_resize(call->id, (int)call->a, (int)call->b); break;
+    case CALL_PIXEL_RATIO: runtime_surface_set_pixel_ratio(call->id, call->a); break;
+    case CALL_MOUSE: runtime_surface_update_mouse(call->id, (float)call->a, (float)call->b, call->c); break;
+    case CALL_SCALE_BOUNDS: runtime_surface_set_scale_bounds(call->id, call->a, call->b); break;
+    case CALL_OVERLAY: runtime_set_telemetry_overlay(call->c); break;
+  }
+  free(call);
+}
+#endif
+
+// Queues the call for the render thread when made from another thread;
+// returns 1 if it did.
+static int forward_call(CallKind kind, int id, double a, double b, int c) {
+#ifdef RUNTIME_WORKER
+  if (pthread_equal(pthread_self(), g_render_thread)) return 0;
+  RuntimeCall *call = malloc(sizeof *call);
+  if (!call) return 1;
+  *call = (RuntimeCall){kind, id, a, b, c};
+  if (!emscripten_proxy_async(emscripten_proxy_get_system_queue(), g_render_thread, run_call, call)) free(call);
+  return 1;
+#else
+  (void)kind; (void)id; (void)a; (void)b; (void)c;
+  return 0;
+#endif
 }
 
+// Runs fn(arg) on the render thread and waits for it when called from
+// another thread; returns 1 if it did. Getters use it to read state the
+// render thread is changing.
+static int sync_call(void (*fn)(void *), void *arg) {
+#ifdef RUNTIME_WORKER
+  if (pthread_equal(pthread_self(), g_render_thread)) return 0;
+  emscripten_proxy_sync(emscripten_proxy_get_system_queue(), g_render_thread, fn, arg);
+  return 1;
+#else
+  (void)fn; (void)arg;
+  return 0;
+#endif
+}
+
+// Starts the demo called `name` on the canvas the loader put in
+// Module.__surfaceCanvas (combined build). Returns the surface id for the
+// runtime_surface_* calls, or -1.
 EMSCRIPTEN_KEEPALIVE
-void set_active(int active) {
+int runtime_open_surface(const char *name, int width, int height) {
+#ifdef RUNTIME_WORKER
+  // Worker builds open surfaces through the port (see runtime_open_port).
+  if (!pthread_equal(pthread_self(), g_render_thread)) return -1;
+#endif
   ensure_context_current();
-  g_active = active ? 1 : 0;
-  demo_app_set_active(g_active);
-  if (!g_active) {
-    g_prev_time = emscripten_get_now() * 0.001;
+  for (int i = 0; i < g_surface_count; ++i) {
+    if (!strcmp(g_surfaces[i].app->name, name)) return -1;
+  }
+  for (int i = 0; i < demo_app_count; ++i) {
+    if (!strcmp(demo_apps[i].name, name)) return open_surface(&demo_apps[i], width, height, 1);
   }
+  return -1;
 }
 
 EMSCRIPTEN_KEEPALIVE
-void resize_canvas(int width, int height) {
+void runtime_surface_set_active(int id, int active) {
+  if (forward_call(CALL_SET_ACTIVE, id, 0.0, 0.0, active)) return;
+  Surface *s = surface_at(id);
+  if (!s) return;
+  ensure_context_current();
+  s->active = active ? 1 : 0;
+  bind_surface(s);
+  s->app->set_active(s->active);
+  if (s->active) wake(s);
+}
+
+// Canvas backing-store size in device pixels; the loader keeps it at the
+// CSS size times devicePixelRatio.
+EMSCRIPTEN_KEEPALIVE
+void runtime_surface_resize(int id, int width, int height) {
+  if (forward_call(CALL_RESIZE, id, width, height, 0)) return;
+  Surface *s = surface_at(id);
+  if (!s || width < 1 || height < 1) return;
+  if (width == s->canvas_w && height == s->canvas_h && s->fbo) return;
+  ensure_context_current();
+#ifdef RUNTIME_WORKER
+  // The page cannot resize a transferred canvas; its OffscreenCanvas is here.
+  if (s->copy) runtime_size_surface_canvas(id, width, height);
+  else emscripten_set_canvas_element_size(g_selector, width, height);
+#endif
+  s->canvas_w = width;
+  s->canvas_h = height;
+  apply_render_size(s);
+}
+
+// Canvas pixels per CSS pixel. The loader sets it ahead of each resize;
+// demos that work in CSS pixels read it with runtime_pixel_ratio(), and a
+// change reaches them as a resize.
+EMSCRIPTEN_KEEPALIVE
+void runtime_surface_set_pixel_ratio(int id, double ratio) {
+  if (forward_call(CALL_PIXEL_RATIO, id, ratio, 0.0, 0)) return;
+  Surface *s = surface_at(id);
+  if (!s || !(ratio > 0.0) || ratio == s->pixel_ratio) return;
+  ensure_context_current();
+  s->pixel_ratio = ratio;
+  bind_surface(s);
+  s->app->resize(s->width, s->height);
+  s->present_pending = 1;
+  wake(s);
+}
+
+double runtime_pixel_ratio(void) {
+  Surface *s = g_bound;
+  if (!s || s->canvas_w < 1) return 1.0;
+  return s->pixel_ratio * s->width / s->canvas_w;
+}
+
+// Render scale bounds relative to the canvas, overriding the demo's; equal
+// bounds pin the scale.
+EMSCRIPTEN_KEEPALIVE
+void runtime_surface_set_scale_bounds(int id, double min_scale, double max_scale) {
+  if (forward_call(CALL_SCALE_BOUNDS, id, min_scale, max_scale, 0)) return;
+  Surface *s = surface_at(id);
+  if (!s) return;
+  ensure_context_current();
+  if (min_scale < 0.125) min_scale = 0.125;
+  if (max_scale < min_scale) max_scale = min_scale;
+  s->min_scale = min_scale;
+  s->max_scale = max_scale;
+  double scale = s->scale < min_scale ? min_scale : s->scale > max_scale ? max_scale : s->scale;
+  if (scale != s->scale) {
+    s->scale = scale;
+    apply_render_size(s);
+  }
+}
+
+typedef struct {
+  int id;
+  double scale;
+} ScaleCall;
+
+static void run_scale_call(void *arg) {
+  ScaleCall *call = arg;
+  Surface *s = surface_at(call->id);
+  call->scale = s ? s->scale : 0.0;
+}
+
+EMSCRIPTEN_KEEPALIVE
+double runtime_surface_get_scale(int id) {
+  ScaleCall call = {id, 0.0};
+  if (!sync_call(run_scale_call, &call)) run_scale_call(&call);
+  return call.scale;
+}
+
+EMSCRIPTEN_KEEPALIVE
+void runtime_surface_update_mouse(int id, float x, float y, int present) {
+  if (forward_call(CALL_MOUSE, id, x, y, present)) return;
+  Surface *s = surface_at(id);
+  if (!s) return;
   ensure_context_current();
-  g_width = width;
-  g_height = height;
-  demo_app_resize(width, height);
+  // Canvas pixels to render-target pixels.
+  float sx = s->canvas_w > 0 ? (float)s->width / (float)s->canvas_w : 1.0f;
+  float sy = s->canvas_h > 0 ? (float)s->height / (float)s->canvas_h : 1.0f;
+  bind_surface(s);
+  s->app->update_mouse(x * sx, y * sy, present);
+  wake(s);
+}
+
+// Telemetry ring of the surface: TELEMETRY_FRAMES records of
+// TELEMETRY_FIELDS floats (see record_frame); entry frames % TELEMETRY_FRAMES
+// is the next to be written. In worker builds the render thread keeps
+// writing while the page reads it, so a view can catch a record half
+// written; runtime_surface_telemetry_json takes a consistent snapshot.
+EMSCRIPTEN_KEEPALIVE
+float *runtime_surface_telemetry(int id) {
+  Surface *s = surface_at(id);
+  return s ? s->telemetry : NULL;
+}
+
+EMSCRIPTEN_KEEPALIVE
+int runtime_surface_telemetry_frames(int id) {
+  Surface *s = surface_at(id);
+  return s ? (int)s->frames : 0;
+}
+
+typedef struct {
+  char *buf;
+  size_t size, len;
+} JsonWriter;
+
+static void json_printf(JsonWriter *w, const char *fmt, ...) __attribute__((format(printf, 2, 3)));
+static void json_printf(JsonWriter *w, const char *fmt, ...) {
+  if (w->len >= w->size) return;
+  va_list args;
+  va_start(args, fmt);
+  int n = vsnprintf(w->buf + w->len, w->size - w->len, fmt, args);
+  va_end(args);
+  w->len = n < 0 ? w->size : w->len + (size_t)n;
+}
+
+static void json_ms(JsonWriter *w, float ms) {
+  if (ms < 0.0f) json_printf(w, "null");
+  else json_printf(w, "%.3f", ms);
+}
+
+static void json_percentiles(JsonWriter *w, const Surface *s, const char *key, int field) {
+  float p[3];
+  int count = telemetry_percentiles(s, field, p);
+  json_printf(w, ",\"%s\":{\"count\":%d,\"p50\":", key, count);
+  json_ms(w, p[0]);
+  json_printf(w, ",\"p95\":");
+  json_ms(w, p[1]);
+  json_printf(w, ",\"p99\":");
+  json_ms(w, p[2]);
+  json_printf(w, "}");
+}
+
+// Writes the surface's telemetry as JSON: percentiles per field and the
+// recorded frames, oldest first, as [interval, cpu, gpu, scale] with null
+// for unknown times. Returns its length, or -1 if it does not fit.
+static int write_telemetry_json(const Surface *s, char *buf, size_t size) {
+  JsonWriter w = {buf, size, 0};
+  json_printf(&w, "{\"demo\":\"%s\",\"frames\":%u,\"canvas\":[%d,%d],\"render\":[%d,%d],\"scale\":%.3f,",
+              s->app->name, s->frames, s->canvas_w, s->canvas_h, s->width, s->height, s->scale);
+  json_printf(&w, "\"gpu_timer\":%s", s->timed ? "true" : "false");
+  json_percentiles(&w, s, "interval_ms", 0);
+  json_percentiles(&w, s, "cpu_ms", 1);
+  json_percentiles(&w, s, "gpu_ms", 2);
+  json_printf(&w, ",\"recent\":[");
+  unsigned total = s->frames < TELEMETRY_FRAMES ? s->frames : TELEMETRY_FRAMES;
+  for (unsigned i = 0; i < total; ++i) {
+    const float *f = &s->telemetry[((s->frames - total + i) % TELEMETRY_FRAMES) * TELEMETRY_FIELDS];
+    json_printf(&w, i ? ",[" : "[");
+    json_ms(&w, f[0]);
+    json_printf(&w, ",");
+    json_ms(&w, f[1]);
+    json_printf(&w, ",");
+    json_ms(&w, f[2]);
+    json_printf(&w, ",%.3f]", f[3]);
+  }
+  json_printf(&w, "]}");
+  return w.len < w.size ? (int)w.len : -1;
+}
+
+typedef struct {
+  int id;
+  char *buf;
+  int size;
+  int len;
+} JsonCall;
+
+static void run_json_call(void *arg) {
+  JsonCall *call = arg;
+  const Surface *s = surface_at(call->id);
+  call->len = s ? write_telemetry_json(s, call->buf, (size_t)call->size) : -1;
+}
+
+// The surface's telemetry JSON (see write_telemetry_json) in `buf`, which
+// the caller owns. Worker builds write it on the render thread, between
+// frames. Returns its length, or -1 for a bad id or too small a buffer.
+EMSCRIPTEN_KEEPALIVE
+int runtime_surface_telemetry_json_into(int id, char *buf, int size) {
+  if (!buf || size <= 0) return -1;
+  JsonCall call = {id, buf, size, -1};
+  if (!sync_call(run_json_call, &call)) run_json_call(&call);
+  return call.len;
+}
+
+// As above, in a buffer of the calling thread that the next call from it
+// overwrites; "null" for a bad id. TELEMETRY_JSON_SIZE fits a full ring.
+EMSCRIPTEN_KEEPALIVE
+const char *runtime_surface_telemetry_json(int id) {
+  static _Thread_local char json[TELEMETRY_JSON_SIZE];
+  return runtime_surface_telemetry_json_into(id, json, sizeof json) < 0 ? "null" : json;
+}
+
+// Draws the frame-time graph (see draw_overlay) over every canvas.
+EMSCRIPTEN_KEEPALIVE
+void runtime_set_telemetry_overlay(int on) {
+  if (forward_call(CALL_OVERLAY, 0, 0.0, 0.0, on)) return;
+  g_overlay = on ? 1 : 0;
+  // Redraw the canvases now, with or without it.
+  for (int i = 0; i < g_surface_count; ++i) g_surfaces[i].present_pending = 1;
+  wake_active();
+}
+
+EMSCRIPTEN_KEEPALIVE
+int runtime_get_telemetry_overlay(void) {
+  return g_overlay;
+}
+
+// 1 in worker builds, where the page hands the canvas over and leaves its
+// size to the runtime.
+EMSCRIPTEN_KEEPALIVE
+int runtime_uses_worker(void) {
+#ifdef RUNTIME_WORKER
+  return 1;
+#else
+  return 0;
+#endif
+}
+
+// Single-demo builds drive surface 0.
+EMSCRIPTEN_KEEPALIVE
+void set_active(int active) {
+  runtime_surface_set_active(0, active);
+}
+
+EMSCRIPTEN_KEEPALIVE
+void resize_canvas(int width, int height) {
+  runtime_surface_resize(0, width, height);
+}
+
+EMSCRIPTEN_KEEPALIVE
+void set_pixel_ratio(double ratio) {
+  runtime_surface_set_pixel_ratio(0, ratio);
+}
+
+EMSCRIPTEN_KEEPALIVE
+void runtime_set_scale_bounds(double min_scale, double max_scale) {
+  runtime_surface_set_scale_bounds(0, min_scale, max_scale);
+}
+
+EMSCRIPTEN_KEEPALIVE
+double runtime_get_scale(void) {
+  return runtime_surface_get_scale(0);
 }
 
 EMSCRIPTEN_KEEPALIVE
 void update_mouse(float x, float y, int present) {
-  g_mouse_x = x;
-  g_mouse_y = y;
-  g_mouse_present = present;
-  demo_app_update_mouse(x, y, present);
+  runtime_surface_update_mouse(0, x, y, present);
+}
+
+EMSCRIPTEN_KEEPALIVE
+float *runtime_telemetry(void) {
+  return runtime_surface_telemetry(0);
+}
+
+EMSCRIPTEN_KEEPALIVE
+int runtime_telemetry_frames(void) {
+  return runtime_surface_telemetry_frames(0);
+}
+
+EMSCRIPTEN_KEEPALIVE
+const char *runtime_telemetry_json(void) {
+  return runtime_surface_telemetry_json(0);
+}
+
+EMSCRIPTEN_KEEPALIVE
+int runtime_telemetry_json_into(char *buf, int size) {
+  return runtime_surface_telemetry_json_into(0, buf, size);
+}
+
+#ifdef RUNTIME_WORKER
+// Runs an export with up to four numeric arguments on the render thread.
+EM_JS(double, runtime_invoke, (const char *name, int count, double a0, double a1, double a2, double a3), {
+  var fn = Module['_' + UTF8ToString(name)];
+  if (!fn) return 0;
+  return +fn.apply(null, [a0, a1, a2, a3].slice(0, count)) || 0;
+});
+
+typedef struct {
+  const char *name;
+  int count;
+  double args[4];
+  double result;
+} ExportCall;
+
+static void run_export_call(void *arg) {
+  ExportCall *call = arg;
+  call->result = runtime_invoke(call->name, call->count, call->args[0], call->args[1], call->args[2], call->args[3]);
+}
+
+// Calls the export `name` (e.g. "tri_get_count") on the render thread and
+// waits for its result. The loader routes the demo's getters through this,
+// since the state they read lives there.
+EMSCRIPTEN_KEEPALIVE
+double runtime_call(const char *name, int count, double a0, double a1, double a2, double a3) {
+  ExportCall call = {name, count < 0 ? 0 : count > 4 ? 4 : count, {a0, a1, a2, a3}, 0.0};
+  if (!sync_call(run_export_call, &call)) run_export_call(&call);
+  return call.result;
+}
+
+typedef struct {
+  ExportCall call;
+  int request;
+} PostedCall;
+
+static void run_posted_call(void *arg) {
+  PostedCall *posted = arg;
+  run_export_call(&posted->call);
+  MAIN_THREAD_ASYNC_EM_ASM({
+    if (Module['__runtimeSettled']) Module['__runtimeSettled']($0, $1);
+  }, posted->request, posted->call.result);
+  free((void *)posted->call.name);
+  free(posted);
+}
+
+// Queues the export `name` (the demo's setters, e.g. "tri_set_count") on
+// the render thread without waiting; its result comes back through
+// Module.__runtimeSettled(request, result).
+EMSCRIPTEN_KEEPALIVE
+void runtime_post(const char *name, int count, double a0, double a1, double a2, double a3, int request) {
+  PostedCall *posted = malloc(sizeof *posted);
+  char *copy = posted ? strdup(name) : NULL;
+  if (!copy) {
+    free(posted);
+    return;
+  }
+  posted->call = (ExportCall){copy, count < 0 ? 0 : count > 4 ? 4 : count, {a0, a1, a2, a3}, 0.0};
+  posted->request = request;
+  if (!emscripten_proxy_async(emscripten_proxy_get_system_queue(), g_render_thread, run_posted_call, posted)) {
+    free(copy);
+    free(posted);
+  }
+}
+
+#ifdef RUNTIME_COMBINED
+// Hands the page a MessagePort (through the 'callHandler' message Emscripten
+// uses for print, to Module.__runtimePort). The page sends each canvas over
+// it as an OffscreenCanvas, with the demo name and size, and the surface is
+// opened here on the render thread; the reply carries its id.
+EM_JS(void, runtime_open_port, (), {
+  var channel = new MessageChannel();
+  var open = Module['cwrap']('runtime_open_surface', 'number', ['string', 'number', 'number']);
+  channel.port1.onmessage = function(e) {
+    var d = e.data;
+    Module['__surfaceCanvas'] = d.canvas;
+    channel.port1.postMessage({request: d.request, surface: open(d.demo, d.width, d.height)});
+  };
+  postMessage({cmd: 'callHandler', handler: '__runtimePort', args: [channel.port2]}, [channel.port2]);
+});
+#endif
+#endif
+
+// Tells the page whether the render thread started; it waits for this
+// before forwarding calls.
+static void notify_ready(int ok) {
+#ifdef RUNTIME_WORKER
+  MAIN_THREAD_ASYNC_EM_ASM({
+    if (Module['__runtimeReady']) Module['__runtimeReady']($0);
+  }, ok);
+#else
+  (void)ok;
+#endif
 }
 
-int main(void) {
+// argv[1], when given, is the canvas selector; worker builds get it that way
+// since their Module does not carry the loader's options.
+int main(int argc, char **argv) {
+#ifdef RUNTIME_WORKER
+  g_render_thread = pthread_self();
+#endif
   EmscriptenWebGLContextAttributes attr;
   emscripten_webgl_init_context_attributes(&attr);
   attr.majorVersion = 2;
@@ -91,25 +1163,43 @@ int main(void) {
   attr.alpha = EM_FALSE;
   attr.depth = EM_FALSE;
   attr.stencil = EM_FALSE;
-  attr.antialias = EM_TRUE;
+  // The canvas receives blits from the offscreen targets, so it is never
+  // multisampled; MSAA lives in those targets instead. Demos that only draw
+  // full-screen fragment passes gain nothing from it; they build with
+  // -DRUNTIME_NO_MSAA and antialias themselves.
+  attr.antialias = EM_FALSE;
   attr.enableExtensionsByDefault = EM_TRUE;
 
-  char *selector = runtime_acquire_selector();
-  g_ctx = emscripten_webgl_create_context(selector, &attr);
-  free(selector);
+#ifdef RUNTIME_COMBINED
+  (void)argc;
+  (void)argv;
+  runtime_create_shared_canvas(SHARED_CANVAS);
+  g_ctx = emscripten_webgl_create_context(SHARED_CANVAS, &attr);
+#ifdef RUNTIME_WORKER
+  if (g_ctx > 0) runtime_open_port();
+#endif
+#else
+  g_selector = argc > 1 ? strdup(argv[1]) : runtime_acquire_selector();
+  g_ctx = emscripten_webgl_create_context(g_selector, &attr);
+#endif
   if (g_ctx <= 0) {
+    notify_ready(0);
     return 1;
   }
   ensure_context_current();
+  glGetIntegerv(GL_MAX_SAMPLES, &g_max_samples);
+  g_gpu_timer = emscripten_webgl_enable_extension(g_ctx, "EXT_disjoint_timer_query_webgl2");
 
-  emscripten_webgl_get_drawing_buffer_size(g_ctx, &g_width, &g_height);
-  demo_app_init(g_width, g_height);
-  demo_app_set_active(0);
+#ifndef RUNTIME_COMBINED
+  int width = 0, height = 0;
+  emscripten_webgl_get_drawing_buffer_size(g_ctx, &width, &height);
+  open_surface(&demo_apps[0], width, height, 0);
+#endif
 
   emscripten_set_keydown_callback(EMSCRIPTEN_EVENT_TARGET_DOCUMENT, NULL, 1, handle_key_event);
   emscripten_set_keyup_callback(EMSCRIPTEN_EVENT_TARGET_DOCUMENT, NULL, 1, handle_key_event);
 
-  g_prev_time = emscripten_get_now() * 0.001;
+  notify_ready(1);
   emscripten_set_main_loop(frame, 0, 1);
   return 0;
 }
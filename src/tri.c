@@ -1,33 +1,109 @@
 #include <GLES3/gl3.h>
+#include <emscripten.h>
 #include <math.h>
 #include <stdint.h>
 #include <stddef.h>
+#include <stdlib.h>
 #ifdef DEBUG
 #include <stdio.h>
 #endif
 
 #include "demo_app.h"
 
-static GLuint g_program = 0;
+// Stress mode: g_count > 0 draws that many rotating triangles in a grid
+// through one of four submission strategies, to measure WebGL call and
+// upload overhead. 0 keeps the single triangle.
+#define MAX_COUNT 200000
+// Triangles per uniform-block range in the UBO strategy; 4 KB, well under
+// the 16 KB every implementation supports.
+#define UBO_BATCH 256
+// Exponential smoothing of the per-strategy timings.
+#define TIMING_SMOOTHING 0.1
+#define STR(x) #x
+#define XSTR(x) STR(x)
+
+enum { STRATEGY_DRAWS, STRATEGY_INSTANCED, STRATEGY_UBO, STRATEGY_MERGED, STRATEGY_COUNT };
+
+typedef struct {
+  GLuint program;
+  GLint time_loc;
+  GLint aspect_loc;
+  GLint place_loc;
+} TriProgram;
+
+// Grid position, size and spin of one triangle: its angle at time t is
+// 0.5 * t * speed + phase.
+typedef struct {
+  float x, y, scale;
+  float speed, phase;
+} TriInstance;
+
+static TriProgram g_single;
+static TriProgram g_programs[STRATEGY_COUNT];
 static GLuint g_vao = 0;
 static GLuint g_vbo = 0;
-static GLint g_time_loc = -1;
-static GLint g_aspect_loc = -1;
 static int g_width = 0;
 static int g_height = 0;
 static int g_active = 0;
 
+static int g_count = 0;
+static int g_strategy = STRATEGY_DRAWS;
+static TriInstance *g_tris = NULL;
+static float *g_scratch = NULL;
+static size_t g_scratch_capacity = 0;
+static float g_layout_aspect = 0.0f;
+static GLuint g_inst_vao = 0;
+static GLuint g_inst_vbo = 0;
+static GLuint g_ubo = 0;
+static GLsizeiptr g_ubo_stride = 0;
+static GLuint g_merged_vao = 0;
+static GLuint g_merged_vbo = 0;
+
+// Smoothed CPU submit time and frame interval per strategy, in ms; 0 until
+// the strategy has run at the current count. With g_cycle_frames > 0 the
+// strategies take turns that many frames each.
+static double g_cpu_ms[STRATEGY_COUNT];
+static double g_frame_ms[STRATEGY_COUNT];
+static int g_cycle_frames = 0;
+static int g_strategy_frames = 0;
+
+static const GLfloat BASE_VERTS[] = {
+    0.0f,  0.6f,  1.0f, 0.4f, 0.4f,
+   -0.6f, -0.4f,  0.4f, 0.8f, 0.4f,
+    0.6f, -0.4f,  0.4f, 0.4f, 1.0f,
+};
+
+// One source for every path; the define picks where a triangle's offset,
+// scale and angle come from. Without one it is the single triangle, and
+// MERGED vertices arrive already placed.
 static const char *VERT_SRC =
-    "#version 300 es\n"
     "layout(location=0) in vec2 a_pos;\n"
     "layout(location=1) in vec3 a_color;\n"
     "out vec3 v_color;\n"
     "uniform float u_time;\n"
     "uniform float u_aspect;\n"
+    "#if defined(INSTANCED)\n"
+    "layout(location=2) in vec3 a_place;\n"
+    "layout(location=3) in vec2 a_spin;\n"
+    "#elif defined(UBO)\n"
+    "layout(std140) uniform Batch { vec4 u_batch[UBO_BATCH]; };\n"
+    "#elif defined(DRAWS)\n"
+    "uniform vec4 u_place;\n"
+    "#endif\n"
     "void main(){\n"
-    "  float angle = u_time * 0.5;\n"
+    "  vec4 place = vec4(0.0, 0.0, 1.0, u_time * 0.5);\n"
+    "#if defined(INSTANCED)\n"
+    "  place = vec4(a_place, u_time * 0.5 * a_spin.x + a_spin.y);\n"
+    "#elif defined(UBO)\n"
+    "  place = u_batch[gl_InstanceID];\n"
+    "#elif defined(DRAWS)\n"
+    "  place = u_place;\n"
+    "#elif defined(MERGED)\n"
+    "  place.w = 0.0;\n"
+    "#endif\n"
+    "  float angle = place.w;\n"
     "  mat2 rot = mat2(cos(angle), -sin(angle), sin(angle), cos(angle));\n"
-    "  vec2 p = rot * a_pos;\n"
+    "  vec2 p = place.xy + rot * a_pos * place.z;\n"
     "  p.x *= u_aspect;\n"
     "  gl_Position = vec4(p, 0.0, 1.0);\n"
     "  v_color = a_color;\n"
@@ -46,9 +122,9 @@ static const char *FRAG_SRC =
     "  fragColor = vec4(bright, 1.0);\n"
     "}\n";
 
-static GLuint compile_shader(GLenum type, const char *src) {
+static GLuint compile_shader(GLenum type, const char *const *srcs, int count) {
   GLuint shader = glCreateShader(type);
-  glShaderSource(shader, 1, &src, NULL);
+  glShaderSource(shader, count, srcs, NULL);
   glCompileShader(shader);
   GLint ok = 0;
   glGetShaderiv(shader, GL_COMPILE_STATUS, &ok);
@@ -87,47 +163,250 @@ static GLuint link_program(GLuint vs, GLuint fs) {
   return prog;
 }
 
+static TriProgram build_program(const char *define) {
+  const char *vs_srcs[] = {"#version 300 es\n", define, "#define UBO_BATCH " XSTR(UBO_BATCH) "\n", VERT_SRC};
+  const char *fs_srcs[] = {FRAG_SRC};
+  GLuint vs = compile_shader(GL_VERTEX_SHADER, vs_srcs, 4);
+  GLuint fs = compile_shader(GL_FRAGMENT_SHADER, fs_srcs, 1);
+  TriProgram p;
+  p.program = link_program(vs, fs);
+  p.time_loc = glGetUniformLocation(p.program, "u_time");
+  p.aspect_loc = glGetUniformLocation(p.program, "u_aspect");
+  p.place_loc = glGetUniformLocation(p.program, "u_place");
+  GLuint block = glGetUniformBlockIndex(p.program, "Batch");
+  if (block != GL_INVALID_INDEX) glUniformBlockBinding(p.program, block, 0);
+  return p;
+}
+
+static void delete_program(TriProgram *p) {
+  if (p->program) glDeleteProgram(p->program);
+  p->program = 0;
+}
+
+// Points the base triangle's attributes (0 and 1) at the bound buffer.
+static void base_attributes(void) {
+  glEnableVertexAttribArray(0);
+  glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 5 * sizeof(GLfloat), (void *)0);
+  glEnableVertexAttribArray(1);
+  glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 5 * sizeof(GLfloat), (void *)(2 * sizeof(GLfloat)));
+}
+
 void demo_app_init(int width, int height) {
   g_width = width;
   g_height = height;
   g_active = 0;
 
-  GLuint vs = compile_shader(GL_VERTEX_SHADER, VERT_SRC);
-  GLuint fs = compile_shader(GL_FRAGMENT_SHADER, FRAG_SRC);
-  g_program = link_program(vs, fs);
-  g_time_loc = glGetUniformLocation(g_program, "u_time");
-  g_aspect_loc = glGetUniformLocation(g_program, "u_aspect");
-
-  const GLfloat verts[] = {
-      0.0f,  0.6f,  1.0f, 0.4f, 0.4f,
-     -0.6f, -0.4f,  0.4f, 0.8f, 0.4f,
-      0.6f, -0.4f,  0.4f, 0.4f, 1.0f,
-  };
+  g_single = build_program("");
+  g_programs[STRATEGY_DRAWS] = build_program("#define DRAWS\n");
+  g_programs[STRATEGY_INSTANCED] = build_program("#define INSTANCED\n");
+  g_programs[STRATEGY_UBO] = build_program("#define UBO\n");
+  g_programs[STRATEGY_MERGED] = build_program("#define MERGED\n");
 
   glGenVertexArrays(1, &g_vao);
   glBindVertexArray(g_vao);
 
   glGenBuffers(1, &g_vbo);
   glBindBuffer(GL_ARRAY_BUFFER, g_vbo);
-  glBufferData(GL_ARRAY_BUFFER, sizeof verts, verts, GL_STATIC_DRAW);
+  glBufferData(GL_ARRAY_BUFFER, sizeof BASE_VERTS, BASE_VERTS, GL_STATIC_DRAW);
+  base_attributes();
 
-  glEnableVertexAttribArray(0);
-  glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 5 * sizeof(GLfloat), (void *)0);
-  glEnableVertexAttribArray(1);
-  glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 5 * sizeof(GLfloat), (void *)(2 * sizeof(GLfloat)));
+  // Instanced: the base triangle plus (x, y, scale) and (speed, phase) per
+  // instance.
+  glGenVertexArrays(1, &g_inst_vao);
+  glBindVertexArray(g_inst_vao);
+  base_attributes();
+  glGenBuffers(1, &g_inst_vbo);
+  glBindBuffer(GL_ARRAY_BUFFER, g_inst_vbo);
+  glEnableVertexAttribArray(2);
+  glVertexAttribPointer(2, 3, GL_FLOAT, GL_FALSE, sizeof(TriInstance), (void *)offsetof(TriInstance, x));
+  glVertexAttribDivisor(2, 1);
+  glEnableVertexAttribArray(3);
+  glVertexAttribPointer(3, 2, GL_FLOAT, GL_FALSE, sizeof(TriInstance), (void *)offsetof(TriInstance, speed));
+  glVertexAttribDivisor(3, 1);
+
+  glGenVertexArrays(1, &g_merged_vao);
+  glBindVertexArray(g_merged_vao);
+  glGenBuffers(1, &g_merged_vbo);
+  glBindBuffer(GL_ARRAY_BUFFER, g_merged_vbo);
+  base_attributes();
+  glBindVertexArray(0);
+
+  glGenBuffers(1, &g_ubo);
+  GLint align = 1;
+  glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &align);
+  if (align < 1) align = 1;
+  g_ubo_stride = (GLsizeiptr)((UBO_BATCH * 4 * sizeof(float) + align - 1) / align * align);
 
   demo_app_resize(width, height);
 }
 
+// Lays g_count triangles out on a grid filling the view, each with its own
+// spin, and uploads the static instance data. Buffers sized by the count
+// are (re)allocated here.
+static int layout_triangles(float aspect) {
+  free(g_tris);
+  g_tris = malloc((size_t)g_count * sizeof *g_tris);
+  size_t batches = ((size_t)g_count + UBO_BATCH - 1) / UBO_BATCH;
+  size_t need = (size_t)g_count * 15;
+  size_t ubo_floats = batches * (size_t)g_ubo_stride / sizeof(float);
+  if (ubo_floats > need) need = ubo_floats;
+  if (need > g_scratch_capacity) {
+    free(g_scratch);
+    g_scratch = malloc(need * sizeof(float));
+    g_scratch_capacity = g_scratch ? need : 0;
+  }
+  if (!g_tris || !g_scratch) {
+    free(g_tris);
+    g_tris = NULL;
+    g_count = 0;
+    return 0;
+  }
+  // The shader squeezes x by aspect (height / width), so the grid spans
+  // [-1 / aspect, 1 / aspect] horizontally.
+  float half_w = 1.0f / aspect;
+  int cols = (int)ceilf(sqrtf((float)g_count * half_w));
+  if (cols < 1) cols = 1;
+  int rows = (g_count + cols - 1) / cols;
+  float cell = fminf(2.0f * half_w / (float)cols, 2.0f / (float)rows);
+  uint32_t h = 2166136261u;
+  for (int i = 0; i < g_count; ++i) {
+    TriInstance *t = &g_tris[i];
+    t->x = -half_w + cell * ((float)(i % cols) + 0.5f);
+    t->y = 1.0f - cell * ((float)(i / cols) + 0.5f);
+    t->scale = cell / 1.5f;
+    h = (h ^ (uint32_t)i) * 16777619u;
+    t->speed = 0.5f + (float)(h >> 8) / 16777216.0f * 1.5f;
+    t->phase = (float)(h & 0xFFu) / 256.0f * 6.2831853f;
+  }
+  glBindBuffer(GL_ARRAY_BUFFER, g_inst_vbo);
+  glBufferData(GL_ARRAY_BUFFER, (GLsizeiptr)g_count * sizeof *g_tris, g_tris, GL_STATIC_DRAW);
+  glBindBuffer(GL_ARRAY_BUFFER, g_merged_vbo);
+  glBufferData(GL_ARRAY_BUFFER, (GLsizeiptr)g_count * 15 * sizeof(float), NULL, GL_STREAM_DRAW);
+  glBindBuffer(GL_UNIFORM_BUFFER, g_ubo);
+  glBufferData(GL_UNIFORM_BUFFER, (GLsizeiptr)batches * g_ubo_stride, NULL, GL_STREAM_DRAW);
+  glBindBuffer(GL_UNIFORM_BUFFER, 0);
+  g_layout_aspect = aspect;
+  return 1;
+}
+
 void demo_app_resize(int width, int height) {
   g_width = width;
   g_height = height;
   glViewport(0, 0, g_width, g_height);
 }
 
-void demo_app_frame(double time_sec, double dt_sec) {
-  (void)dt_sec;
-  if (!g_active) return;
+static float tri_angle(const TriInstance *t, float time_sec) {
+  return 0.5f * time_sec * t->speed + t->phase;
+}
+
+static void use_program(const TriProgram *p, float time_sec, float aspect) {
+  glUseProgram(p->program);
+  if (p->time_loc >= 0) {
+    glUniform1f(p->time_loc, time_sec);
+  }
+  if (p->aspect_loc >= 0) {
+    glUniform1f(p->aspect_loc, aspect);
+  }
+}
+
+// One uniform update and one draw call per triangle.
+static void draw_per_call(float t, float aspect) {
+  const TriProgram *p = &g_programs[STRATEGY_DRAWS];
+  use_program(p, t, aspect);
+  glBindVertexArray(g_vao);
+  for (int i = 0; i < g_count; ++i) {
+    const TriInstance *tri = &g_tris[i];
+    glUniform4f(p->place_loc, tri->x, tri->y, tri->scale, tri_angle(tri, t));
+    glDrawArrays(GL_TRIANGLES, 0, 3);
+  }
+}
+
+// Static per-instance attributes, spun on the GPU: one draw, no uploads.
+static void draw_instanced(float t, float aspect) {
+  use_program(&g_programs[STRATEGY_INSTANCED], t, aspect);
+  glBindVertexArray(g_inst_vao);
+  glDrawArraysInstanced(GL_TRIANGLES, 0, 3, g_count);
+}
+
+// Placements computed on the CPU, uploaded in one buffer update and drawn
+// UBO_BATCH instances per bound range.
+static void draw_ubo(float t, float aspect) {
+  size_t stride = (size_t)g_ubo_stride / sizeof(float);
+  int batches = (g_count + UBO_BATCH - 1) / UBO_BATCH;
+  for (int i = 0; i < g_count; ++i) {
+    const TriInstance *tri = &g_tris[i];
+    float *v = g_scratch + (size_t)(i / UBO_BATCH) * stride + (size_t)(i % UBO_BATCH) * 4;
+    v[0] = tri->x;
+    v[1] = tri->y;
+    v[2] = tri->scale;
+    v[3] = tri_angle(tri, t);
+  }
+  use_program(&g_programs[STRATEGY_UBO], t, aspect);
+  glBindBuffer(GL_UNIFORM_BUFFER, g_ubo);
+  glBufferData(GL_UNIFORM_BUFFER, (GLsizeiptr)batches * g_ubo_stride, NULL, GL_STREAM_DRAW);
+  glBufferSubData(GL_UNIFORM_BUFFER, 0, (GLsizeiptr)batches * g_ubo_stride, g_scratch);
+  glBindVertexArray(g_vao);
+  for (int b = 0; b < batches; ++b) {
+    int n = g_count - b * UBO_BATCH < UBO_BATCH ? g_count - b * UBO_BATCH : UBO_BATCH;
+    glBindBufferRange(GL_UNIFORM_BUFFER, 0, g_ubo, (GLintptr)b * g_ubo_stride, g_ubo_stride);
+    glDrawArraysInstanced(GL_TRIANGLES, 0, 3, n);
+  }
+}
+
+// Every vertex transformed on the CPU into one streamed buffer: a single
+// plain draw, paid for with the upload.
+static void draw_merged(float t, float aspect) {
+  float *v = g_scratch;
+  for (int i = 0; i < g_count; ++i) {
+    const TriInstance *tri = &g_tris[i];
+    float angle = tri_angle(tri, t);
+    float c = cosf(angle) * tri->scale, s = sinf(angle) * tri->scale;
+    for (int k = 0; k < 3; ++k) {
+      const GLfloat *b = &BASE_VERTS[5 * k];
+      // Same rotation as mat2(c, -s, s, c) * p in the shader.
+      v[0] = tri->x + c * b[0] + s * b[1];
+      v[1] = tri->y - s * b[0] + c * b[1];
+      v[2] = b[2];
+      v[3] = b[3];
+      v[4] = b[4];
+      v += 5;
+    }
+  }
+  use_program(&g_programs[STRATEGY_MERGED], t, aspect);
+  glBindBuffer(GL_ARRAY_BUFFER, g_merged_vbo);
+  // Orphaned every frame so the upload never waits on the previous draw.
+  glBufferData(GL_ARRAY_BUFFER, (GLsizeiptr)g_count * 15 * sizeof(float), NULL, GL_STREAM_DRAW);
+  glBufferSubData(GL_ARRAY_BUFFER, 0, (GLsizeiptr)g_count * 15 * sizeof(float), g_scratch);
+  glBindVertexArray(g_merged_vao);
+  glDrawArrays(GL_TRIANGLES, 0, 3 * g_count);
+}
+
+static void record_timing(int strategy, double cpu_ms, double dt_sec) {
+  double *cpu = &g_cpu_ms[strategy];
+  double *frame = &g_frame_ms[strategy];
+  *cpu = *cpu > 0.0 ? *cpu + TIMING_SMOOTHING * (cpu_ms - *cpu) : cpu_ms;
+  // The interval that ends now was spent mostly on the previous frame, so
+  // the first frame after a switch is not counted.
+  if (g_strategy_frames > 0 && dt_sec > 0.0) {
+    double ms = dt_sec * 1e3;
+    *frame = *frame > 0.0 ? *frame + TIMING_SMOOTHING * (ms - *frame) : ms;
+  }
+  g_strategy_frames++;
+  if (g_cycle_frames > 0 && g_strategy_frames >= g_cycle_frames) {
+    g_strategy = (g_strategy + 1) % STRATEGY_COUNT;
+    g_strategy_frames = 0;
+#ifdef DEBUG
+    if (g_strategy == 0) {
+      printf("tri stress %d: draws %.2f/%.2f instanced %.2f/%.2f ubo %.2f/%.2f merged %.2f/%.2f ms (cpu/frame)\n",
+             g_count, g_cpu_ms[0], g_frame_ms[0], g_cpu_ms[1], g_frame_ms[1], g_cpu_ms[2], g_frame_ms[2],
+             g_cpu_ms[3], g_frame_ms[3]);
+    }
+#endif
+  }
+}
+
+int demo_app_frame(double time_sec, double dt_sec) {
+  if (!g_active) return 0;
 
   float t = (float)time_sec;
   float aspect = (g_height > 0) ? ((float)g_height / (float)g_width) : 1.0f;
@@ -136,16 +415,24 @@ void demo_app_frame(double time_sec, double dt_sec) {
   glClearColor(0.05f, 0.08f, 0.12f, 1.0f);
   glClear(GL_COLOR_BUFFER_BIT);
 
-  glUseProgram(g_program);
-  if (g_time_loc >= 0) {
-    glUniform1f(g_time_loc, t);
-  }
-  if (g_aspect_loc >= 0) {
-    glUniform1f(g_aspect_loc, aspect);
+  if (g_count > 0 && (aspect != g_layout_aspect || !g_tris)) layout_triangles(aspect);
+  if (g_count == 0) {
+    use_program(&g_single, t, aspect);
+    glBindVertexArray(g_vao);
+    glDrawArrays(GL_TRIANGLES, 0, 3);
+    return DEMO_FRAME_DRAWN | DEMO_FRAME_AGAIN;
   }
 
-  glBindVertexArray(g_vao);
-  glDrawArrays(GL_TRIANGLES, 0, 3);
+  int strategy = g_strategy;
+  double start_ms = emscripten_get_now();
+  switch (strategy) {
+    case STRATEGY_DRAWS: draw_per_call(t, aspect); break;
+    case STRATEGY_INSTANCED: draw_instanced(t, aspect); break;
+    case STRATEGY_UBO: draw_ubo(t, aspect); break;
+    default: draw_merged(t, aspect); break;
+  }
+  record_timing(strategy, emscripten_get_now() - start_ms, dt_sec);
+  return DEMO_FRAME_DRAWN | DEMO_FRAME_AGAIN;
 }
 
 void demo_app_set_active(int active) {
@@ -153,23 +440,90 @@ void demo_app_set_active(int active) {
 }
 
 void demo_app_shutdown(void) {
-  if (g_vbo) {
-    glDeleteBuffers(1, &g_vbo);
-    g_vbo = 0;
-  }
-  if (g_vao) {
-    glDeleteVertexArrays(1, &g_vao);
-    g_vao = 0;
-  }
-  if (g_program) {
-    glDeleteProgram(g_program);
-    g_program = 0;
+  GLuint buffers[] = {g_vbo, g_inst_vbo, g_merged_vbo, g_ubo};
+  GLuint arrays[] = {g_vao, g_inst_vao, g_merged_vao};
+  glDeleteBuffers(4, buffers);
+  glDeleteVertexArrays(3, arrays);
+  g_vbo = g_inst_vbo = g_merged_vbo = g_ubo = 0;
+  g_vao = g_inst_vao = g_merged_vao = 0;
+  delete_program(&g_single);
+  for (int i = 0; i < STRATEGY_COUNT; ++i) delete_program(&g_programs[i]);
+  free(g_tris);
+  g_tris = NULL;
+  free(g_scratch);
+  g_scratch = NULL;
+  g_scratch_capacity = 0;
+  g_layout_aspect = 0.0f;
+}
+
+static void reset_timings(void) {
+  for (int i = 0; i < STRATEGY_COUNT; ++i) g_cpu_ms[i] = g_frame_ms[i] = 0.0;
+  g_strategy_frames = 0;
+}
+
+// Number of stress triangles (0 turns stress mode off), capped at
+// MAX_COUNT. Timings restart.
+EMSCRIPTEN_KEEPALIVE
+int tri_set_count(int count) {
+  if (count < 0) count = 0;
+  if (count > MAX_COUNT) count = MAX_COUNT;
+  g_count = count;
+  g_layout_aspect = 0.0f;
+  reset_timings();
+  return g_count;
+}
+
+EMSCRIPTEN_KEEPALIVE
+int tri_get_count(void) {
+  return g_count;
+}
+
+// 0: a uniform update and draw call per triangle; 1: instanced with
+// per-instance attributes; 2: UBO batches; 3: one merged dynamic VBO.
+EMSCRIPTEN_KEEPALIVE
+int tri_set_strategy(int strategy) {
+  if (strategy >= 0 && strategy < STRATEGY_COUNT) {
+    g_strategy = strategy;
+    g_strategy_frames = 0;
   }
+  return g_strategy;
 }
 
+EMSCRIPTEN_KEEPALIVE
+int tri_get_strategy(void) {
+  return g_strategy;
+}
+
+// Smoothed CPU time spent issuing a frame with `strategy`, in ms.
+EMSCRIPTEN_KEEPALIVE
+double tri_get_cpu_ms(int strategy) {
+  return (strategy >= 0 && strategy < STRATEGY_COUNT) ? g_cpu_ms[strategy] : 0.0;
+}
+
+// Smoothed frame interval while `strategy` was drawing, in ms.
+EMSCRIPTEN_KEEPALIVE
+double tri_get_frame_ms(int strategy) {
+  return (strategy >= 0 && strategy < STRATEGY_COUNT) ? g_frame_ms[strategy] : 0.0;
+}
+
+// Rotates through the strategies every `frames` frames (0 stops), so one
+// run measures all four.
+EMSCRIPTEN_KEEPALIVE
+void tri_set_cycle(int frames) {
+  g_cycle_frames = frames > 0 ? frames : 0;
+  g_strategy_frames = 0;
+}
+
+// Z halves the stress count, X doubles it (starting stress mode at 1024),
+// C switches to the next strategy.
 void demo_app_handle_key(int key, int pressed) {
-  (void)key;
-  (void)pressed;
+  if (!pressed) return;
+  switch (key) {
+    case 4: tri_set_count(g_count / 2); break;
+    case 5: tri_set_count(g_count > 0 ? g_count * 2 : 1024); break;
+    case 6: tri_set_strategy((g_strategy + 1) % STRATEGY_COUNT); break;
+    default: break;
+  }
 }
 
 void demo_app_update_mouse(float x, float y, int present) {
@@ -0,0 +1,153 @@
+#include "workpool.h"
+
+#if defined(__EMSCRIPTEN__) && !defined(__EMSCRIPTEN_PTHREADS__)
+#define WORKPOOL_THREADS 0
+#else
+#define WORKPOOL_THREADS 1
+#endif
+
+#if WORKPOOL_THREADS
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <unistd.h>
+#ifdef __EMSCRIPTEN__
+#include <emscripten/threading.h>
+#endif
+#endif
+
+#define WORKPOOL_MAX_THREADS 16
+
+#if WORKPOOL_THREADS
+
+static pthread_t g_threads[WORKPOOL_MAX_THREADS];
+static int g_worker_count = 0;
+static int g_started = 0;
+
+static pthread_mutex_t g_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t g_wake = PTHREAD_COND_INITIALIZER;
+static pthread_barrier_t g_done;
+static unsigned g_generation = 0;
+static int g_stop = 0;
+
+static workpool_task g_task = 0;
+static void *g_ctx = 0;
+static int g_count = 0;
+static int g_chunk = 1;
+static atomic_int g_next;
+
+static int logical_cores(void) {
+#ifdef __EMSCRIPTEN__
+  return emscripten_num_logical_cores();
+#else
+  long n = sysconf(_SC_NPROCESSORS_ONLN);
+  return n > 0 ? (int)n : 1;
+#endif
+}
+
+static void drain(void) {
+  for (;;) {
+    int begin = atomic_fetch_add_explicit(&g_next, g_chunk, memory_order_relaxed);
+    if (begin >= g_count) break;
+    int end = begin + g_chunk;
+    if (end > g_count) end = g_count;
+    g_task(g_ctx, begin, end);
+  }
+}
+
+// `arg` is the generation current when the pool started; g_generation
+// carries over from earlier pools, and a worker that read it only once
+// running could miss the first workpool_run.
+static void *worker_main(void *arg) {
+  unsigned seen = (unsigned)(uintptr_t)arg;
+  for (;;) {
+    pthread_mutex_lock(&g_lock);
+    while (g_generation == seen && !g_stop) {
+      pthread_cond_wait(&g_wake, &g_lock);
+    }
+    seen = g_generation;
+    int stop = g_stop;
+    pthread_mutex_unlock(&g_lock);
+    if (stop) break;
+    drain();
+    pthread_barrier_wait(&g_done);
+  }
+  return 0;
+}
+
+int workpool_start(int threads) {
+  if (g_started) return g_worker_count + 1;
+  if (threads <= 0) threads = logical_cores();
+  if (threads > WORKPOOL_MAX_THREADS) threads = WORKPOOL_MAX_THREADS;
+  pthread_mutex_lock(&g_lock);
+  g_stop = 0;
+  unsigned generation = g_generation;
+  pthread_mutex_unlock(&g_lock);
+  g_worker_count = 0;
+  for (int i = 0; i < threads - 1; ++i) {
+    if (pthread_create(&g_threads[i], 0, worker_main, (void *)(uintptr_t)generation) != 0) break;
+    g_worker_count++;
+  }
+  pthread_barrier_init(&g_done, 0, (unsigned)g_worker_count + 1);
+  g_started = 1;
+  return g_worker_count + 1;
+}
+
+int workpool_size(void) {
+  return g_started ? g_worker_count + 1 : 1;
+}
+
+void workpool_run(workpool_task task, void *ctx, int count, int chunk) {
+  if (count <= 0) return;
+  if (chunk < 1) chunk = 1;
+  if (!g_started || g_worker_count == 0 || count <= chunk) {
+    task(ctx, 0, count);
+    return;
+  }
+  pthread_mutex_lock(&g_lock);
+  g_task = task;
+  g_ctx = ctx;
+  g_count = count;
+  g_chunk = chunk;
+  atomic_store_explicit(&g_next, 0, memory_order_relaxed);
+  g_generation++;
+  pthread_cond_broadcast(&g_wake);
+  pthread_mutex_unlock(&g_lock);
+
+  drain();
+  pthread_barrier_wait(&g_done);
+}
+
+void workpool_stop(void) {
+  if (!g_started) return;
+  pthread_mutex_lock(&g_lock);
+  g_stop = 1;
+  pthread_cond_broadcast(&g_wake);
+  pthread_mutex_unlock(&g_lock);
+  for (int i = 0; i < g_worker_count; ++i) {
+    pthread_join(g_threads[i], 0);
+  }
+  pthread_barrier_destroy(&g_done);
+  g_worker_count = 0;
+  g_started = 0;
+}
+
+#else
+
+int workpool_start(int threads) {
+  (void)threads;
+  return 1;
+}
+
+int workpool_size(void) {
+  return 1;
+}
+
+void workpool_run(workpool_task task, void *ctx, int count, int chunk) {
+  (void)chunk;
+  if (count > 0) task(ctx, 0, count);
+}
+
+void workpool_stop(void) {}
+
+#endif
@@ -0,0 +1,19 @@
+#ifndef WORKPOOL_H
+#define WORKPOOL_H
+
+// Range task: processes items [begin, end) of a job.
+typedef void (*workpool_task)(void *ctx, int begin, int end);
+
+// Starts the shared pool. threads <= 0 picks one thread per logical core
+// (capped at WORKPOOL_MAX_THREADS); the calling thread counts as one of
+// them. Returns the number of threads that will run jobs.
+int workpool_start(int threads);
+int workpool_size(void);
+
+// Splits [0, count) into chunks of `chunk` items, runs them across the
+// pool and the calling thread, and returns once every chunk has finished.
+void workpool_run(workpool_task task, void *ctx, int count, int chunk);
+
+void workpool_stop(void);
+
+#endif /* WORKPOOL_H */